@@ -0,0 +1,335 @@
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+// Small self-contained microbenchmark harness.
+// Include from exactly one translation unit per executable: it replaces the
+// global operator new/delete to count allocations.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef PSAPI_VERSION
+#define PSAPI_VERSION 2
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+
+namespace BenchUtils {
+
+    inline std::atomic<uint64_t>& allocationCounter() {
+        static std::atomic<uint64_t> count{0};
+        return count;
+    }
+
+    inline std::atomic<uint64_t>& allocatedBytes() {
+        static std::atomic<uint64_t> bytes{0};
+        return bytes;
+    }
+
+    template<typename T>
+    inline void doNotOptimize(const T& value) {
+    #if defined(__GNUC__) || defined(__clang__)
+        asm volatile("" : : "r,m"(value) : "memory");
+    #else
+        static volatile const void* sink;
+        sink = &value;
+    #endif
+    }
+
+    inline void clobberMemory() {
+    #if defined(__GNUC__) || defined(__clang__)
+        asm volatile("" : : : "memory");
+    #endif
+    }
+
+    // user + system CPU time of the whole process
+    inline double processCpuSeconds() {
+    #if defined(_WIN32)
+        FILETIME creation, exit, kernel, user;
+        if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) {
+            return 0.0;
+        }
+        auto toSeconds = [](const FILETIME& ft) {
+            ULARGE_INTEGER v;
+            v.LowPart = ft.dwLowDateTime;
+            v.HighPart = ft.dwHighDateTime;
+            return static_cast<double>(v.QuadPart) * 1e-7;
+        };
+        return toSeconds(kernel) + toSeconds(user);
+    #else
+        struct rusage ru;
+        if (getrusage(RUSAGE_SELF, &ru) != 0) {
+            return 0.0;
+        }
+        return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1e-6;
+    #endif
+    }
+
+    // memory high-water mark (peak working set / max RSS) in bytes
+    inline uint64_t peakMemoryBytes() {
+    #if defined(_WIN32)
+        PROCESS_MEMORY_COUNTERS pmc;
+        if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) {
+            return 0;
+        }
+        return static_cast<uint64_t>(pmc.PeakWorkingSetSize);
+    #else
+        struct rusage ru;
+        if (getrusage(RUSAGE_SELF, &ru) != 0) {
+            return 0;
+        }
+    #if defined(__APPLE__)
+        return static_cast<uint64_t>(ru.ru_maxrss);
+    #else
+        return static_cast<uint64_t>(ru.ru_maxrss) * 1024;
+    #endif
+    #endif
+    }
+
+    inline std::string jsonEscape(const std::string& s) {
+        static const char* hex = "0123456789abcdef";
+        std::string out;
+        out.reserve(s.size());
+        for (unsigned char c : s) {
+            switch (c) {
+                case '"':  out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\n': out += "\\n";  break;
+                case '\r': out += "\\r";  break;
+                case '\t': out += "\\t";  break;
+                default:
+                    if (c < 0x20) {
+                        out += "\\u00";
+                        out.push_back(hex[c >> 4]);
+                        out.push_back(hex[c & 0xf]);
+                    }
+                    else {
+                        out.push_back(static_cast<char>(c));
+                    }
+            }
+        }
+        return out;
+    }
+
+}
+
+
+// GCC cannot see that these pair up with the replaced operator new below
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(std::size_t size) {
+    BenchUtils::allocationCounter().fetch_add(1, std::memory_order_relaxed);
+    BenchUtils::allocatedBytes().fetch_add(size, std::memory_order_relaxed);
+    if (void* p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+
+struct BenchResult {
+    std::string name;
+    uint64_t iterations = 0;
+    double ns_per_op = 0.0;
+    double min_ns_per_op = 0.0;
+    double allocs_per_op = 0.0;
+    double bytes_allocated_per_op = 0.0;
+    double ops_per_sec = 0.0;
+    double mb_per_sec = 0.0;
+};
+
+
+class BenchRunner {
+
+    public:
+
+        // The body runs `iterations` operations per call
+        using Body = std::function<void(uint64_t iterations)>;
+
+        BenchRunner(int argc, char** argv) {
+            for (int i = 1; i < argc; ++i) {
+                std::string arg = argv[i];
+                if (arg == "--json" && i + 1 < argc) {
+                    json_path_ = argv[++i];
+                }
+                else if (arg == "--filter" && i + 1 < argc) {
+                    filter_ = argv[++i];
+                }
+                else if (arg == "--min-time-ms" && i + 1 < argc) {
+                    min_time_ms_ = std::atof(argv[++i]);
+                }
+                else if (arg == "--repetitions" && i + 1 < argc) {
+                    repetitions_ = std::max(1, std::atoi(argv[++i]));
+                }
+                else if (arg == "--label" && i + 1 < argc) {
+                    label_ = argv[++i];
+                }
+            }
+        }
+
+        // bytes_per_op > 0 adds a MB/s column
+        void run(const std::string& name, uint64_t bytes_per_op, const Body& body) {
+
+            if (!filter_.empty() && name.find(filter_) == std::string::npos) {
+                return;
+            }
+
+            body(1);
+
+            uint64_t iterations = 1;
+            while (true) {
+                double ns = timeOnce(body, iterations);
+                if (ns >= min_time_ms_ * 1e6 || iterations >= (1ull << 40)) {
+                    break;
+                }
+                double scale = ns > 0 ? (min_time_ms_ * 1e6 * 1.2) / ns : 100.0;
+                scale = std::min(100.0, std::max(2.0, scale));
+                iterations = static_cast<uint64_t>(iterations * scale);
+            }
+
+            std::vector<double> samples;
+            uint64_t allocs = 0;
+            uint64_t bytes = 0;
+            for (int r = 0; r < repetitions_; ++r) {
+                const uint64_t a0 = BenchUtils::allocationCounter().load();
+                const uint64_t b0 = BenchUtils::allocatedBytes().load();
+                samples.push_back(timeOnce(body, iterations) / static_cast<double>(iterations));
+                allocs += BenchUtils::allocationCounter().load() - a0;
+                bytes += BenchUtils::allocatedBytes().load() - b0;
+            }
+            std::sort(samples.begin(), samples.end());
+
+            BenchResult res;
+            res.name = name;
+            res.iterations = iterations;
+            res.ns_per_op = samples[samples.size() / 2];
+            res.min_ns_per_op = samples.front();
+            const double total_ops = static_cast<double>(iterations) * repetitions_;
+            res.allocs_per_op = allocs / total_ops;
+            res.bytes_allocated_per_op = bytes / total_ops;
+            res.ops_per_sec = res.ns_per_op > 0 ? 1e9 / res.ns_per_op : 0.0;
+            res.mb_per_sec = bytes_per_op > 0 ? (bytes_per_op * res.ops_per_sec) / (1024.0 * 1024.0) : 0.0;
+
+            print(res);
+            results_.push_back(res);
+        }
+
+        // Writes the JSON report if --json was given; returns the process exit code
+        int finish() {
+            if (json_path_.empty()) {
+                return 0;
+            }
+            std::ofstream ofs(json_path_, std::ios::binary);
+            if (!ofs) {
+                std::cerr << "bench: unable to write " << json_path_ << '\n';
+                return 1;
+            }
+
+            ofs << std::setprecision(6) << std::fixed;
+            ofs << "{\n  \"label\": \"" << BenchUtils::jsonEscape(label_) << "\",\n";
+            ofs << "  \"timestamp\": " << static_cast<long long>(std::time(nullptr)) << ",\n";
+            ofs << "  \"compiler\": \"" << BenchUtils::jsonEscape(compiler()) << "\",\n";
+            ofs << "  \"benchmarks\": [";
+            for (size_t i = 0; i < results_.size(); ++i) {
+                const BenchResult& r = results_[i];
+                ofs << (i ? ",\n" : "\n")
+                    << "    {\"name\": \"" << BenchUtils::jsonEscape(r.name) << "\""
+                    << ", \"iterations\": " << r.iterations
+                    << ", \"ns_per_op\": " << r.ns_per_op
+                    << ", \"min_ns_per_op\": " << r.min_ns_per_op
+                    << ", \"allocs_per_op\": " << r.allocs_per_op
+                    << ", \"bytes_allocated_per_op\": " << r.bytes_allocated_per_op
+                    << ", \"ops_per_sec\": " << r.ops_per_sec
+                    << ", \"mb_per_sec\": " << r.mb_per_sec << '}';
+            }
+            ofs << "\n  ]\n}\n";
+            std::cout << "Results written to " << json_path_ << '\n';
+            return ofs ? 0 : 1;
+        }
+
+    private:
+
+        static double timeOnce(const Body& body, uint64_t iterations) {
+            auto start = std::chrono::steady_clock::now();
+            body(iterations);
+            BenchUtils::clobberMemory();
+            auto end = std::chrono::steady_clock::now();
+            return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+        }
+
+        static std::string compiler() {
+        #if defined(__clang__)
+            return std::string("clang ") + __clang_version__;
+        #elif defined(__GNUC__)
+            return std::string("gcc ") + __VERSION__;
+        #elif defined(_MSC_VER)
+            return "msvc " + std::to_string(_MSC_VER);
+        #else
+            return "unknown";
+        #endif
+        }
+
+        void print(const BenchResult& r) {
+            if (!header_printed_) {
+                std::cout << std::left << std::setw(40) << "benchmark"
+                          << std::right << std::setw(14) << "ns/op"
+                          << std::setw(12) << "allocs/op"
+                          << std::setw(16) << "ops/s"
+                          << std::setw(12) << "MB/s" << '\n';
+                header_printed_ = true;
+            }
+            std::cout << std::left << std::setw(40) << r.name << std::right << std::fixed
+                      << std::setw(14) << std::setprecision(1) << r.ns_per_op
+                      << std::setw(12) << std::setprecision(2) << r.allocs_per_op
+                      << std::setw(16) << std::setprecision(0) << r.ops_per_sec
+                      << std::setw(12) << std::setprecision(1) << r.mb_per_sec << '\n';
+        }
+
+        std::vector<BenchResult> results_;
+        std::string json_path_;
+        std::string filter_;
+        std::string label_;
+        double min_time_ms_ = 200.0;
+        int repetitions_ = 5;
+        bool header_printed_ = false;
+
+};
+
+#endif
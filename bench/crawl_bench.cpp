@@ -0,0 +1,227 @@
+#include "bench.hpp"
+#include "synthetic_web.hpp"
+#include "thread_pool.hpp"
+#include "downloader.hpp"
+#include "crawler.hpp"
+#include <iostream>
+#include <memory>
+
+// End-to-end crawl throughput against the synthetic web.
+//   crawl_bench [graph options] [--threads N] [--max-pages N] [--connect] [--index dir] [--json out.json]
+//               [--dns-latency MS] [--no-dns-prefetch]
+// By default the server runs in-process, so CPU per page includes serving it. With
+// --connect the driver crawls an already running synthetic_web_server started with the
+// same graph options and a fixed --base-port instead. --dns-latency names the hosts
+// hN.synthetic.test and resolves them through a stub that takes MS per lookup.
+
+int main(int argc, char** argv) {
+
+    SyntheticWebConfig config;
+    config.hosts = 8;
+    config.pages_per_host = 500;
+
+    int threads = 8;
+    size_t max_pages = static_cast<size_t>(-1);
+    bool connect = false;
+    bool http2 = false;
+    bool compression = true;
+    long streams = 16;
+    std::string json_path;
+    std::string download_dir = "bench_downloads";
+    std::string index_dir;
+    int dns_latency_ms = -1;
+    bool dns_prefetch = true;
+
+    for (int i = 1; i < argc; ++i) {
+        int used = SyntheticWebUtils::parseConfigArg(config, argc, argv, i);
+        const std::string arg = argv[i];
+        if (used > 0) {
+            i += used - 1;
+        }
+        else if (arg == "--threads" && i + 1 < argc) {
+            threads = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (arg == "--max-pages" && i + 1 < argc) {
+            max_pages = static_cast<size_t>(std::atoll(argv[++i]));
+        }
+        else if (arg == "--download-dir" && i + 1 < argc) {
+            download_dir = argv[++i];
+        }
+        else if (arg == "--index" && i + 1 < argc) {
+            index_dir = argv[++i];
+        }
+        else if (arg == "--json" && i + 1 < argc) {
+            json_path = argv[++i];
+        }
+        else if (arg == "--connect") {
+            connect = true;
+        }
+        else if (arg == "--http2") {
+            http2 = true;
+        }
+        else if (arg == "--no-compression") {
+            compression = false;
+        }
+        else if (arg == "--streams" && i + 1 < argc) {
+            streams = std::atol(argv[++i]);
+        }
+        else if (arg == "--dns-latency" && i + 1 < argc) {
+            dns_latency_ms = std::max(0, std::atoi(argv[++i]));
+            config.named_hosts = true;
+        }
+        else if (arg == "--no-dns-prefetch") {
+            dns_prefetch = false;
+        }
+        else {
+            std::cerr << "unknown argument: " << arg << '\n';
+            return 2;
+        }
+    }
+
+    if (connect && config.base_port == 0) {
+        std::cerr << "--connect needs the server's --base-port\n";
+        return 2;
+    }
+
+    SyntheticWebServer server(config);
+    std::vector<std::string> seeds;
+    if (connect) {
+        for (int h = 0; h < config.hosts; ++h) {
+            const std::string name = config.named_hosts ? "h" + std::to_string(h) + ".synthetic.test" : "127.0.0.1";
+            seeds.push_back("http://" + name + ":" + std::to_string(config.base_port + h) + "/");
+        }
+    }
+    else {
+        if (!server.start()) {
+            std::cerr << "failed to start synthetic web server\n";
+            return 1;
+        }
+        for (int h = 0; h < config.hosts; ++h) {
+            seeds.push_back(server.hostUrl(h));
+        }
+    }
+
+    ThreadPool pool;
+    pool.start(threads);
+
+    Downloader& downloader = Downloader::instance(pool, download_dir, "ArdaCrawlerBench/1.0");
+    downloader.setHttp2(http2);
+    downloader.setCompression(compression);
+    downloader.setMaxStreamsPerHost(streams);
+    downloader.setDnsPrefetch(dns_prefetch);
+    if (dns_latency_ms >= 0) {
+        downloader.dns().setResolver([dns_latency_ms](const std::string& host) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(dns_latency_ms));
+            const std::string suffix = ".synthetic.test";
+            const bool ours = host.size() > suffix.size() &&
+                              host.compare(host.size() - suffix.size(), suffix.size(), suffix) == 0;
+            return ours ? DnsAnswer{{"127.0.0.1"}, -1} : DnsAnswer{};
+        });
+    }
+    Crawler& crawler = Crawler::instance(downloader);
+    crawler.setMaxPages(max_pages);
+    crawler.setMaxInFlight(static_cast<size_t>(threads) * 4);
+    for (const auto& s : seeds) {
+        crawler.seed(s);
+    }
+    std::unique_ptr<InvertedIndex> index;
+    if (!index_dir.empty()) {
+        index = std::make_unique<InvertedIndex>(index_dir);
+        crawler.setIndex(index.get());
+    }
+
+    const uint64_t allocs_before = BenchUtils::allocationCounter().load();
+    const double cpu_before = BenchUtils::processCpuSeconds();
+    const auto wall_start = std::chrono::steady_clock::now();
+
+    crawler.run();
+
+    const auto wall_end = std::chrono::steady_clock::now();
+    const double cpu = BenchUtils::processCpuSeconds() - cpu_before;
+    const uint64_t allocs = BenchUtils::allocationCounter().load() - allocs_before;
+
+    pool.stop();
+    if (!connect) {
+        server.stop();
+    }
+    if (index) {
+        crawler.setIndex(nullptr);
+        index->close();
+    }
+
+    const CrawlStats stats = crawler.stats();
+    const double wall = std::chrono::duration<double>(wall_end - wall_start).count();
+    const double pages = static_cast<double>(std::max<uint64_t>(1, stats.pages_fetched));
+
+    const double pages_per_sec = stats.pages_fetched / wall;
+    const double cpu_ms_per_page = cpu * 1000.0 / pages;
+    const double peak_mb = BenchUtils::peakMemoryBytes() / (1024.0 * 1024.0);
+
+    std::cout << std::fixed << std::setprecision(2)
+              << "pages fetched:      " << stats.pages_fetched << " (" << stats.pages_ok << " ok, " << stats.pages_failed << " failed, "
+              << stats.retries << " retries)\n"
+              << "bytes:              " << stats.bytes << '\n'
+              << "wall time:          " << wall << " s\n"
+              << "pages/sec:          " << pages_per_sec << '\n'
+              << "MB/sec:             " << stats.bytes / wall / (1024.0 * 1024.0) << '\n'
+              << "CPU ms per page:    " << cpu_ms_per_page << (connect ? "\n" : " (includes in-process server)\n")
+              << "allocs per page:    " << allocs / pages << '\n'
+              << "peak memory:        " << peak_mb << " MB\n";
+
+    const PagePoolStats pool_stats = downloader.pages().stats();
+    std::cout << "page slabs:         " << pool_stats.slabs_total << " live, " << pool_stats.reused << " of "
+              << pool_stats.acquired << " acquisitions reused, " << pool_stats.bytes_reserved / 1024 << " KiB reserved\n";
+
+    uint64_t wire = 0, decoded = 0, connections = 0, h2 = 0;
+    std::cout << "\nper-host state (limit / in flight / latency ms / completed / throttled / timeouts / connections / wire KiB):\n";
+    for (const auto& kv : downloader.hosts().snapshot()) {
+        const HostState& h = kv.second;
+        std::cout << "  " << kv.first << "  " << h.limit << " / " << h.in_flight << " / " << h.latency_ewma_ms
+                  << " / " << h.completed << " / " << h.throttled << " / " << h.timeouts
+                  << " / " << h.connections_opened << " / " << h.wire_bytes / 1024 << '\n';
+        wire += h.wire_bytes;
+        decoded += h.decoded_bytes;
+        connections += h.connections_opened;
+        h2 += h.http2_transfers;
+    }
+    std::cout << "wire / decoded:     " << wire / 1024 << " / " << decoded / 1024 << " KiB, "
+              << connections << " connections opened, " << h2 << " HTTP/2 transfers\n";
+    const LinkGraphStats graph = crawler.graph().stats();
+    std::cout << "link graph:         " << graph.nodes << " nodes, " << graph.edges << " edges (+"
+              << graph.pending_edges << " pending), " << graph.bytesPerEdge() << " bytes/edge ("
+              << graph.csrBytesPerEdge() << " in the CSR), "
+              << graph.compactions << " re-rankings\n";
+    const DnsStats dns = downloader.dns().stats();
+    std::cout << "dns:                " << dns.lookups << " lookups, " << dns.hitRate() * 100.0 << "% hits, "
+              << dns.joined << " joined, " << dns.misses << " misses, " << dns.prefetches << " prefetched, "
+              << dns.meanResolveMs() << " ms mean resolve\n";
+    if (index) {
+        const IndexStats is = index->stats();
+        std::cout << "index:              " << is.docs << " docs, " << is.docsPerSec() << " docs/sec per thread, "
+                  << is.segments << " segment(s), " << is.merges << " merges, " << is.disk_bytes / 1024 << " KiB\n";
+    }
+
+    if (!json_path.empty()) {
+        std::ofstream ofs(json_path, std::ios::binary);
+        ofs << std::fixed << std::setprecision(4)
+            << "{\n  \"hosts\": " << config.hosts
+            << ",\n  \"pages_per_host\": " << config.pages_per_host
+            << ",\n  \"threads\": " << threads
+            << ",\n  \"in_process_server\": " << (connect ? "false" : "true")
+            << ",\n  \"pages_fetched\": " << stats.pages_fetched
+            << ",\n  \"pages_ok\": " << stats.pages_ok
+            << ",\n  \"bytes\": " << stats.bytes
+            << ",\n  \"wall_seconds\": " << wall
+            << ",\n  \"pages_per_sec\": " << pages_per_sec
+            << ",\n  \"cpu_ms_per_page\": " << cpu_ms_per_page
+            << ",\n  \"allocs_per_page\": " << allocs / pages
+            << ",\n  \"peak_memory_bytes\": " << BenchUtils::peakMemoryBytes()
+            << "\n}\n";
+        if (!ofs) {
+            std::cerr << "unable to write " << json_path << '\n';
+            return 1;
+        }
+    }
+
+    return 0;
+}
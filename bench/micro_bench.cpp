@@ -0,0 +1,312 @@
+#include "bench.hpp"
+#include "thread_pool.hpp"
+#include "logger.hpp"
+#include "downloader.hpp"
+#include "parser.hpp"
+#include "sitemap.hpp"
+#include "encoding.hpp"
+#include "extractor.hpp"
+#include "selector.hpp"
+#include <cstring>
+#include <atomic>
+#include <random>
+#include <thread>
+
+
+class NullSink: public Sink {
+
+    public:
+
+        void log(const LogRecord& record) override {
+            if (!shouldLog(record.level)) {
+                return;
+            }
+            BenchUtils::doNotOptimize(record.message.size());
+        }
+
+};
+
+
+static std::string makeHtml(size_t target_size, uint32_t seed) {
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<int> word_len(2, 10);
+    std::uniform_int_distribution<int> pick(0, 9);
+
+    auto word = [&]() {
+        std::string w;
+        int n = word_len(gen);
+        for (int i = 0; i < n; ++i) {
+            w.push_back(static_cast<char>('a' + gen() % 26));
+        }
+        return w;
+    };
+
+    std::string html = "<!DOCTYPE html>\n<html><head><title>Synthetic page</title>"
+                       "<meta charset=\"utf-8\"><style>body { margin: 0 }</style>"
+                       "<script>var x = 1 < 2;</script></head><body>\n";
+    int link = 0;
+    while (html.size() < target_size) {
+        switch (pick(gen)) {
+            case 0:
+                html += "<div class=\"nav item\" id=\"n" + std::to_string(link) + "\">";
+                html += "<a href=\"/wiki/" + word() + "?id=" + std::to_string(link++) + "\">" + word() + "</a></div>\n";
+                break;
+            case 1:
+                html += "<!-- " + word() + " -->";
+                break;
+            case 2:
+                html += "<img src='/img/" + word() + ".png' alt=" + word() + " />";
+                break;
+            default:
+                html += "<p>";
+                for (int i = 0; i < 12; ++i) {
+                    html += word();
+                    html += ' ';
+                }
+                html += "&amp; <b>" + word() + "</b></p>\n";
+        }
+    }
+    html += "</body></html>\n";
+    return html;
+}
+
+
+static void benchThreadPool(BenchRunner& runner, int workers, int producers) {
+
+    ThreadPool pool;
+    pool.start(workers);
+
+    std::atomic<uint64_t> done{0};
+
+    const std::string name = "threadpool/enqueue_run/w" + std::to_string(workers) + "_p" + std::to_string(producers);
+
+    runner.run(name, 0, [&](uint64_t iterations) {
+        done.store(0);
+        const uint64_t per_producer = iterations / producers;
+        const uint64_t total = per_producer * producers + iterations % producers;
+
+        std::vector<std::thread> threads;
+        for (int p = 0; p < producers; ++p) {
+            uint64_t n = per_producer + (p == 0 ? iterations % producers : 0);
+            threads.emplace_back([&pool, &done, n]() {
+                for (uint64_t i = 0; i < n; ++i) {
+                    pool.enqueue([&done]() { done.fetch_add(1, std::memory_order_relaxed); });
+                }
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        while (done.load(std::memory_order_relaxed) < total) {
+            std::this_thread::yield();
+        }
+    });
+
+    pool.stop();
+}
+
+
+int main(int argc, char** argv) {
+
+    BenchRunner runner(argc, argv);
+
+    const int hw = std::max(2u, std::thread::hardware_concurrency());
+    benchThreadPool(runner, 1, 1);
+    benchThreadPool(runner, std::min(hw, 4), 1);
+    benchThreadPool(runner, std::min(hw, 4), 4);
+
+    {
+        auto& logger = Logger::instance();
+        logger.clearSinks();
+        logger.addSink(std::make_shared<NullSink>());
+
+        logger.setLevel(LoggerUtils::Level::INFO);
+        runner.run("logger/enabled_info", 0, [](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; ++i) {
+                LOG_INFO("fetched ", i, " pages from ", "example.com");
+            }
+        });
+
+        logger.setLevel(LoggerUtils::Level::ERROR);
+        runner.run("logger/disabled_debug", 0, [](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; ++i) {
+                LOG_DEBUG("fetched ", i, " pages from ", "example.com");
+            }
+        });
+
+        logger.clearSinks();
+    }
+
+    {
+        const std::vector<std::string> urls = {
+            "https://www.britannica.com",
+            "https://www.britannica.com/money/u3-unemployment-vs-u6-underemployment",
+            "https://www.britannica.com/event/2025-NBA-Betting-and-Gambling-Scandal",
+            "http://Example.COM/a/b/c/../d.html?x=1&y=%20two#frag",
+            "https://en.wikipedia.org/wiki/C%2B%2B_(programming_language)",
+            "https://shop.example.org/search?q=long+query+string&page=12&sort=price_desc",
+        };
+
+        size_t bytes = 0;
+        for (const auto& u : urls) {
+            bytes += u.size();
+        }
+
+        runner.run("downloader/url_to_filename", bytes / urls.size(), [&](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; ++i) {
+                std::string f = Downloader::urlToFilename(urls[i % urls.size()]);
+                BenchUtils::doNotOptimize(f);
+            }
+        });
+
+        const std::string component = "2025-NBA Betting & Gambling: Scandal (part 1)";
+        runner.run("downloader/sanitize_component", component.size(), [&](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; ++i) {
+                std::string s = Downloader::sanitizeComponent(component);
+                BenchUtils::doNotOptimize(s);
+            }
+        });
+    }
+
+    {
+        const std::string html = makeHtml(128 * 1024, 42);
+
+        runner.run("parser/tokenize_128k", html.size(), [&](uint64_t iterations) {
+            HtmlToken token;
+            for (uint64_t i = 0; i < iterations; ++i) {
+                HtmlTokenizer tokenizer(html);
+                size_t count = 0;
+                while (tokenizer.next(token)) {
+                    ++count;
+                }
+                BenchUtils::doNotOptimize(count);
+            }
+        });
+    }
+
+    {
+        std::string xml = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                          "<urlset xmlns=\"http://www.sitemaps.org/schemas/sitemap/0.9\">\n";
+        for (int i = 0; i < 10000; ++i) {
+            xml += "  <url>\n    <loc>https://www.example.com/section/" + std::to_string(i % 97) + "/article-" +
+                   std::to_string(i) + ".html</loc>\n    <lastmod>2024-03-" + std::to_string(10 + i % 18) +
+                   "</lastmod>\n    <priority>0.6</priority>\n  </url>\n";
+        }
+        xml += "</urlset>\n";
+
+        // fed in 16 KiB pieces, as a network transfer would deliver it
+        runner.run("sitemap/parse_10k_urls", xml.size(), [&](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; ++i) {
+                size_t count = 0;
+                SitemapStream stream([&count](SitemapEntry&& e, SitemapUtils::EntryType) {
+                    count += e.loc.size();
+                });
+                for (size_t off = 0; off < xml.size(); off += 16384) {
+                    stream.write(xml.data() + off, std::min<size_t>(16384, xml.size() - off));
+                }
+                stream.finish();
+                BenchUtils::doNotOptimize(count);
+            }
+        });
+    }
+
+    {
+        // the encoding stage against a plain copy of the same bytes
+        const std::string html = makeHtml(256 * 1024, 7);
+        std::string cjk;
+        while (cjk.size() < html.size()) {
+            cjk += "<p>\xe6\x97\xa5\xe6\x9c\xac\xe8\xaa\x9e\xe3\x81\xae\xe3\x83\x9a\xe3\x83\xbc\xe3\x82\xb8 text</p>\n";
+        }
+        std::string latin1 = html;
+        for (size_t i = 0; i < latin1.size(); i += 61) {
+            latin1[i] = static_cast<char>(0xE9);
+        }
+
+        std::vector<char> copy(html.size());
+        runner.run("encoding/memcpy_256k", html.size(), [&](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; ++i) {
+                std::memcpy(copy.data(), html.data(), html.size());
+                BenchUtils::doNotOptimize(copy[i % copy.size()]);
+            }
+        });
+
+        runner.run("encoding/validate_utf8_ascii_256k", html.size(), [&](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; ++i) {
+                BenchUtils::doNotOptimize(EncodingUtils::isValidUtf8(html));
+            }
+        });
+
+        runner.run("encoding/validate_utf8_cjk_256k", cjk.size(), [&](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; ++i) {
+                BenchUtils::doNotOptimize(EncodingUtils::isValidUtf8(cjk));
+            }
+        });
+
+        EncodingInfo info;
+        info.charset = Charset::Windows1252;
+        std::string out;
+        runner.run("encoding/windows1252_to_utf8_256k", latin1.size(), [&](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; ++i) {
+                out.clear();
+                EncodingUtils::toUtf8(latin1, info, out);
+                BenchUtils::doNotOptimize(out.size());
+            }
+        });
+    }
+
+    {
+        const std::string html = makeHtml(128 * 1024, 42);
+
+        Extractor extractor;
+        ExtractedPage page;
+        runner.run("extractor/extract_128k", html.size(), [&](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; ++i) {
+                extractor.extract(html, page);
+                BenchUtils::doNotOptimize(page.text.size());
+            }
+        });
+
+        std::string text;
+        while (text.size() < 64 * 1024) {
+            text += "Fish &amp; chips &mdash; caf&eacute; prices &#8364;5 &lt;incl. tax&gt; and plain words after. ";
+        }
+        std::string out;
+        runner.run("extractor/decode_entities_64k", text.size(), [&](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; ++i) {
+                out.clear();
+                ParserUtils::decodeEntities(text, out);
+                BenchUtils::doNotOptimize(out.size());
+            }
+        });
+    }
+
+    {
+        const std::string html = makeHtml(128 * 1024, 42);
+        ThreadPool pool;
+        Parser& parser = Parser::instance(pool);
+
+        runner.run("parser/build_tree_128k", html.size(), [&](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; ++i) {
+                std::unique_ptr<Node> root = parser.parse(html);
+                BenchUtils::doNotOptimize(root->children.size());
+            }
+        });
+
+        // extraction-rule shaped selectors, matched together in one walk
+        SelectorSet selectors;
+        for (const char* rule : {"div.nav a[href]", "#n10", "p > b", "img[src$='.png']", "div.item > a",
+                                 "body p", "link[rel=canonical]", "meta[name=description]", ".price", "a[href*='?id=1']"}) {
+            selectors.add(rule);
+        }
+        std::unique_ptr<Node> root = parser.parse(html);
+        runner.run("selector/match_10_rules_128k", html.size(), [&](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; ++i) {
+                size_t count = 0;
+                selectors.match(*root, [&count](int, const Node&) { ++count; });
+                BenchUtils::doNotOptimize(count);
+            }
+        });
+    }
+
+    return runner.finish();
+}
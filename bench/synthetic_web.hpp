@@ -0,0 +1,589 @@
+#ifndef SYNTHETIC_WEB_HPP
+#define SYNTHETIC_WEB_HPP
+
+// Deterministic stand-in for the web: every host is a listening port on 127.0.0.1
+// serving a generated link graph. The same config and seed always produce the
+// same pages, links, statuses and latencies, so crawl runs are comparable.
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Built with zlib, the server gzips bodies for clients that send Accept-Encoding: gzip
+#if defined(SYNTHETIC_WEB_GZIP)
+#include <zlib.h>
+#endif
+
+
+struct SyntheticWebConfig {
+    int hosts = 4;
+    int pages_per_host = 1000;
+    int fanout = 10;                 // links per page
+    double cross_host_ratio = 0.2;   // fraction of links pointing at another host
+    size_t min_page_bytes = 8 * 1024;
+    size_t max_page_bytes = 64 * 1024;
+    int min_latency_ms = 0;
+    int max_latency_ms = 0;
+    int body_ms = 0;                 // headers go out at once, the body trickles out over this long
+    double error_rate = 0.0;         // pages answering 500
+    double redirect_rate = 0.0;      // pages answering 301 to a sibling page
+    double disallowed_ratio = 0.0;   // links into /private/, which robots.txt disallows
+    int host_capacity = 0;           // concurrent requests per host before it answers 429 (0 = unlimited)
+    int retry_after_s = 1;           // Retry-After sent with those 429s
+    uint64_t seed = 1;
+    int base_port = 0;               // 0 = ephemeral ports
+    bool named_hosts = false;        // URLs name host N "hN.synthetic.test" instead of 127.0.0.1
+};
+
+
+namespace SyntheticWebUtils {
+
+#if defined(_WIN32)
+    using socket_t = SOCKET;
+    constexpr socket_t invalid_socket = INVALID_SOCKET;
+    inline void closeSocket(socket_t s) { closesocket(s); }
+#else
+    using socket_t = int;
+    constexpr socket_t invalid_socket = -1;
+    inline void closeSocket(socket_t s) { ::close(s); }
+#endif
+
+    inline uint64_t mix(uint64_t x) {
+        x += 0x9e3779b97f4a7c15ull;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+        return x ^ (x >> 31);
+    }
+
+    inline double unit(uint64_t x) {
+        return static_cast<double>(x >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    // Consumes a "--flag value" pair at argv[i] if it is a graph option; returns the
+    // number of arguments used (0 if argv[i] is not one of ours)
+    inline int parseConfigArg(SyntheticWebConfig& c, int argc, char** argv, int i) {
+        if (i + 1 >= argc) {
+            return 0;
+        }
+        const std::string arg = argv[i];
+        const char* v = argv[i + 1];
+        if (arg == "--hosts") c.hosts = std::max(1, std::atoi(v));
+        else if (arg == "--pages") c.pages_per_host = std::max(1, std::atoi(v));
+        else if (arg == "--fanout") c.fanout = std::max(0, std::atoi(v));
+        else if (arg == "--cross-host") c.cross_host_ratio = std::atof(v);
+        else if (arg == "--min-bytes") c.min_page_bytes = static_cast<size_t>(std::atoll(v));
+        else if (arg == "--max-bytes") c.max_page_bytes = static_cast<size_t>(std::atoll(v));
+        else if (arg == "--min-latency-ms") c.min_latency_ms = std::atoi(v);
+        else if (arg == "--max-latency-ms") c.max_latency_ms = std::atoi(v);
+        else if (arg == "--body-ms") c.body_ms = std::atoi(v);
+        else if (arg == "--error-rate") c.error_rate = std::atof(v);
+        else if (arg == "--redirect-rate") c.redirect_rate = std::atof(v);
+        else if (arg == "--disallowed") c.disallowed_ratio = std::atof(v);
+        else if (arg == "--seed") c.seed = static_cast<uint64_t>(std::atoll(v));
+        else if (arg == "--base-port") c.base_port = std::atoi(v);
+        else if (arg == "--host-capacity") c.host_capacity = std::atoi(v);
+        else if (arg == "--retry-after") c.retry_after_s = std::atoi(v);
+        else return 0;
+        return 2;
+    }
+
+    inline bool acceptsGzip(const std::string& head) {
+        std::string lower(head);
+        for (auto& c : lower) {
+            c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        }
+        size_t p = lower.find("\r\naccept-encoding:");
+        if (p == std::string::npos) {
+            return false;
+        }
+        size_t end = lower.find("\r\n", p + 2);
+        return lower.substr(p, end - p).find("gzip") != std::string::npos;
+    }
+
+#if defined(SYNTHETIC_WEB_GZIP)
+    inline bool gzip(const std::string& in, std::string& out) {
+        z_stream zs{};
+        if (deflateInit2(&zs, Z_BEST_SPEED, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            return false;
+        }
+        out.resize(deflateBound(&zs, static_cast<uLong>(in.size())));
+        zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+        zs.avail_in = static_cast<uInt>(in.size());
+        zs.next_out = reinterpret_cast<Bytef*>(&out[0]);
+        zs.avail_out = static_cast<uInt>(out.size());
+        const int rc = deflate(&zs, Z_FINISH);
+        out.resize(zs.total_out);
+        deflateEnd(&zs);
+        return rc == Z_STREAM_END;
+    }
+#endif
+
+    inline const std::string& fillerText() {
+        static const std::string text = [] {
+            static const char* words[] = {
+                "crawler", "frontier", "latency", "socket", "buffer", "parser", "token", "anchor",
+                "document", "history", "encyclopedia", "article", "market", "science", "river",
+                "mountain", "theory", "network", "archive", "museum", "language", "protocol",
+                "economy", "season", "league", "planet", "village", "engine", "harbor", "library"
+            };
+            std::string t;
+            uint64_t s = 7;
+            while (t.size() < 16 * 1024) {
+                s = mix(s);
+                t += words[s % (sizeof(words) / sizeof(words[0]))];
+                t += (s >> 8) % 13 == 0 ? ". " : " ";
+            }
+            return t;
+        }();
+        return text;
+    }
+
+}
+
+
+class SyntheticWebServer {
+
+    public:
+
+        explicit SyntheticWebServer(const SyntheticWebConfig& config) : config_(config) {}
+
+        ~SyntheticWebServer() {
+            stop();
+        }
+
+        SyntheticWebServer(const SyntheticWebServer&) = delete;
+        SyntheticWebServer& operator=(const SyntheticWebServer&) = delete;
+
+        bool start() {
+
+            if (running_) {
+                return true;
+            }
+
+        #if defined(_WIN32)
+            WSADATA wsa;
+            if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+                return false;
+            }
+        #endif
+
+            for (int h = 0; h < config_.hosts; ++h) {
+                SyntheticWebUtils::socket_t s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+                if (s == SyntheticWebUtils::invalid_socket) {
+                    closeListeners();
+                    return false;
+                }
+                int yes = 1;
+                setsockopt(s, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&yes), sizeof(yes));
+
+                sockaddr_in addr{};
+                addr.sin_family = AF_INET;
+                addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+                addr.sin_port = htons(static_cast<uint16_t>(config_.base_port == 0 ? 0 : config_.base_port + h));
+
+                if (bind(s, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(s, 512) != 0) {
+                    SyntheticWebUtils::closeSocket(s);
+                    closeListeners();
+                    return false;
+                }
+
+                socklen_t len = sizeof(addr);
+                getsockname(s, reinterpret_cast<sockaddr*>(&addr), &len);
+                listeners_.push_back(s);
+                ports_.push_back(ntohs(addr.sin_port));
+            }
+
+            active_.reset(new std::atomic<int>[listeners_.size()]);
+            for (size_t h = 0; h < listeners_.size(); ++h) {
+                active_[h] = 0;
+            }
+
+            running_ = true;
+            for (size_t h = 0; h < listeners_.size(); ++h) {
+                acceptors_.emplace_back(&SyntheticWebServer::acceptLoop, this, static_cast<int>(h));
+            }
+            return true;
+        }
+
+        void stop() {
+
+            if (!running_) {
+                return;
+            }
+            running_ = false;
+
+            for (auto& t : acceptors_) {
+                t.join();
+            }
+            acceptors_.clear();
+            closeListeners();
+
+            std::unique_lock<std::mutex> lock(mutex_);
+            idle_.wait(lock, [this] { return connections_ == 0; });
+
+        #if defined(_WIN32)
+            WSACleanup();
+        #endif
+        }
+
+        int port(int host) const {
+            return ports_.at(host);
+        }
+
+        // What URLs call the machine serving host; names resolve to 127.0.0.1 through the driver's resolver
+        std::string hostName(int host) const {
+            return config_.named_hosts ? "h" + std::to_string(host) + ".synthetic.test" : "127.0.0.1";
+        }
+
+        std::string hostUrl(int host) const {
+            return "http://" + hostName(host) + ":" + std::to_string(port(host)) + "/";
+        }
+
+        std::string pageUrl(int host, int page) const {
+            return "http://" + hostName(host) + ":" + std::to_string(port(host)) + "/p/" + std::to_string(page);
+        }
+
+        uint64_t requestsServed() const {
+            return requests_.load();
+        }
+
+        uint64_t bytesServed() const {
+            return bytes_.load();
+        }
+
+        // What a request for `path` on `host` answers; exposed so tests and drivers can predict it
+        struct Response {
+            int status = 200;
+            std::string content_type = "text/html; charset=utf-8";
+            std::string location;
+            std::string body;
+            int latency_ms = 0;
+            int retry_after_s = 0;
+        };
+
+        Response respond(int host, const std::string& path) const {
+
+            Response r;
+            const uint64_t hs = SyntheticWebUtils::mix(config_.seed ^ (static_cast<uint64_t>(host) << 40));
+
+            if (path == "/robots.txt") {
+                r.content_type = "text/plain";
+                r.body = "User-agent: *\nDisallow: /private/\n";
+                return r;
+            }
+
+            int page = -1;
+            bool is_private = false;
+            if (path == "/" || path.empty()) {
+                page = 0;
+            }
+            else if (path.compare(0, 3, "/p/") == 0) {
+                page = std::atoi(path.c_str() + 3);
+            }
+            else if (path.compare(0, 9, "/private/") == 0) {
+                page = std::atoi(path.c_str() + 9);
+                is_private = true;
+            }
+
+            if (page < 0 || page >= config_.pages_per_host) {
+                r.status = 404;
+                r.body = "<html><body>not found</body></html>";
+                return r;
+            }
+
+            const uint64_t ps = SyntheticWebUtils::mix(hs ^ static_cast<uint64_t>(page));
+            const double roll = SyntheticWebUtils::unit(ps);
+
+            if (config_.max_latency_ms > 0) {
+                const int span = config_.max_latency_ms - config_.min_latency_ms;
+                r.latency_ms = config_.min_latency_ms + (span > 0 ? static_cast<int>((ps >> 7) % (span + 1)) : 0);
+            }
+
+            if (page != 0 && roll < config_.error_rate) {
+                r.status = 500;
+                r.body = "<html><body>internal error</body></html>";
+                return r;
+            }
+            if (page != 0 && roll < config_.error_rate + config_.redirect_rate) {
+                r.status = 301;
+                r.location = "/p/" + std::to_string((page + 1) % config_.pages_per_host);
+                return r;
+            }
+
+            const size_t span = config_.max_page_bytes > config_.min_page_bytes ? config_.max_page_bytes - config_.min_page_bytes : 0;
+            const size_t target = config_.min_page_bytes + (span > 0 ? static_cast<size_t>((ps >> 13) % (span + 1)) : 0);
+
+            std::string& b = r.body;
+            b.reserve(target + 256);
+            b += "<!DOCTYPE html>\n<html><head><meta charset=\"utf-8\"><title>Host ";
+            b += std::to_string(host);
+            b += is_private ? " private " : " page ";
+            b += std::to_string(page);
+            b += "</title></head><body>\n<ul class=\"nav\">\n";
+
+            for (int k = 0; k < config_.fanout; ++k) {
+                const uint64_t ls = SyntheticWebUtils::mix(ps + static_cast<uint64_t>(k) + 1);
+                const double lroll = SyntheticWebUtils::unit(ls);
+                int target_host = host;
+                if (config_.hosts > 1 && lroll < config_.cross_host_ratio) {
+                    target_host = static_cast<int>((ls >> 17) % static_cast<uint64_t>(config_.hosts));
+                }
+                const int target_page = static_cast<int>((ls >> 33) % static_cast<uint64_t>(config_.pages_per_host));
+                const bool disallowed = SyntheticWebUtils::unit(SyntheticWebUtils::mix(ls)) < config_.disallowed_ratio;
+
+                b += "<li><a href=\"";
+                if (target_host != host) {
+                    b += "http://";
+                    b += hostName(target_host);
+                    b += ':';
+                    b += std::to_string(ports_.empty() ? 0 : ports_[target_host]);
+                }
+                b += disallowed ? "/private/" : "/p/";
+                b += std::to_string(target_page);
+                b += "\">link ";
+                b += std::to_string(k);
+                b += "</a></li>\n";
+            }
+            b += "</ul>\n<article>\n";
+
+            const std::string& filler = SyntheticWebUtils::fillerText();
+            size_t offset = static_cast<size_t>(ps % (filler.size() / 2));
+            while (b.size() + 32 < target) {
+                const size_t chunk = std::min<size_t>(target - b.size() - 32, 600);
+                b += "<p>";
+                const size_t avail = filler.size() - offset;
+                b.append(filler, offset, std::min(chunk, avail));
+                b += "</p>\n";
+                offset = (offset + chunk * 7) % (filler.size() / 2);
+            }
+            b += "</article></body></html>\n";
+            return r;
+        }
+
+    private:
+
+        void closeListeners() {
+            for (auto s : listeners_) {
+                SyntheticWebUtils::closeSocket(s);
+            }
+            listeners_.clear();
+        }
+
+        void acceptLoop(int host) {
+
+            SyntheticWebUtils::socket_t listener = listeners_[host];
+
+            while (running_) {
+                fd_set set;
+                FD_ZERO(&set);
+                FD_SET(listener, &set);
+                timeval tv{0, 100000};
+                int ready = select(static_cast<int>(listener) + 1, &set, nullptr, nullptr, &tv);
+                if (ready <= 0) {
+                    continue;
+                }
+
+                SyntheticWebUtils::socket_t client = accept(listener, nullptr, nullptr);
+                if (client == SyntheticWebUtils::invalid_socket) {
+                    continue;
+                }
+
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    ++connections_;
+                }
+                std::thread(&SyntheticWebServer::serveConnection, this, host, client).detach();
+            }
+        }
+
+        void serveConnection(int host, SyntheticWebUtils::socket_t client) {
+
+            int yes = 1;
+            setsockopt(client, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&yes), sizeof(yes));
+        #if defined(_WIN32)
+            DWORD timeout = 200;
+            setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+        #else
+            timeval timeout{0, 200000};
+            setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        #endif
+
+            std::string in;
+            char buf[4096];
+            auto last_activity = std::chrono::steady_clock::now();
+
+            while (running_) {
+
+                size_t header_end = in.find("\r\n\r\n");
+                if (header_end == std::string::npos) {
+                    int n = recv(client, buf, sizeof(buf), 0);
+                    if (n > 0) {
+                        in.append(buf, static_cast<size_t>(n));
+                        last_activity = std::chrono::steady_clock::now();
+                        continue;
+                    }
+                    if (n == 0 || std::chrono::steady_clock::now() - last_activity > std::chrono::seconds(5)) {
+                        break;
+                    }
+                    continue;
+                }
+
+                const std::string head = in.substr(0, header_end);
+                in.erase(0, header_end + 4);
+
+                size_t sp1 = head.find(' ');
+                size_t sp2 = sp1 == std::string::npos ? std::string::npos : head.find(' ', sp1 + 1);
+                std::string target = sp2 == std::string::npos ? "/" : head.substr(sp1 + 1, sp2 - sp1 - 1);
+                size_t q = target.find('?');
+                if (q != std::string::npos) {
+                    target.erase(q);
+                }
+
+                bool close_after = head.find("\r\nConnection: close") != std::string::npos ||
+                                   head.find("\r\nconnection: close") != std::string::npos ||
+                                   head.find("HTTP/1.0") != std::string::npos;
+
+                const int active = ++active_[host];
+                Response r;
+                if (config_.host_capacity > 0 && active > config_.host_capacity) {
+                    r.status = 429;
+                    r.retry_after_s = config_.retry_after_s;
+                    r.body = "<html><body>slow down</body></html>";
+                }
+                else {
+                    r = respond(host, target);
+                }
+                if (r.latency_ms > 0) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(r.latency_ms));
+                }
+
+                bool gzipped = false;
+            #if defined(SYNTHETIC_WEB_GZIP)
+                if (r.body.size() > 256 && SyntheticWebUtils::acceptsGzip(head)) {
+                    std::string compressed;
+                    if (SyntheticWebUtils::gzip(r.body, compressed)) {
+                        r.body.swap(compressed);
+                        gzipped = true;
+                    }
+                }
+            #endif
+
+                std::string out = "HTTP/1.1 " + std::to_string(r.status) + statusText(r.status);
+                out += "\r\nContent-Type: " + r.content_type;
+                out += "\r\nContent-Length: " + std::to_string(r.body.size());
+                if (gzipped) {
+                    out += "\r\nContent-Encoding: gzip";
+                }
+                if (!r.location.empty()) {
+                    out += "\r\nLocation: " + r.location;
+                }
+                if (r.retry_after_s > 0) {
+                    out += "\r\nRetry-After: " + std::to_string(r.retry_after_s);
+                }
+                out += close_after ? "\r\nConnection: close\r\n\r\n" : "\r\nConnection: keep-alive\r\n\r\n";
+
+                bool sent = true;
+                if (config_.body_ms > 0) {
+                    // a fast first byte followed by a slow body, in ten evenly spaced slices
+                    sent = sendAll(client, out);
+                    const size_t slice = r.body.size() / 10 + 1;
+                    for (size_t at = 0; sent && at < r.body.size(); at += slice) {
+                        std::this_thread::sleep_for(std::chrono::milliseconds(config_.body_ms / 10));
+                        sent = sendAll(client, r.body.substr(at, slice));
+                    }
+                    out += r.body;
+                }
+                else {
+                    out += r.body;
+                    sent = sendAll(client, out);
+                }
+                --active_[host];
+                if (!sent) {
+                    break;
+                }
+                requests_.fetch_add(1);
+                bytes_.fetch_add(out.size());
+
+                if (close_after) {
+                    break;
+                }
+            }
+
+            SyntheticWebUtils::closeSocket(client);
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (--connections_ == 0) {
+                idle_.notify_all();
+            }
+        }
+
+        static const char* statusText(int status) {
+            switch (status) {
+                case 200: return " OK";
+                case 301: return " Moved Permanently";
+                case 404: return " Not Found";
+                case 429: return " Too Many Requests";
+                default:  return " Internal Server Error";
+            }
+        }
+
+        static bool sendAll(SyntheticWebUtils::socket_t s, const std::string& data) {
+            size_t sent = 0;
+            while (sent < data.size()) {
+            #if defined(_WIN32)
+                int n = send(s, data.data() + sent, static_cast<int>(data.size() - sent), 0);
+            #else
+                ssize_t n = send(s, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            #endif
+                if (n <= 0) {
+                    return false;
+                }
+                sent += static_cast<size_t>(n);
+            }
+            return true;
+        }
+
+        SyntheticWebConfig config_;
+        std::vector<SyntheticWebUtils::socket_t> listeners_;
+        std::vector<int> ports_;
+        std::vector<std::thread> acceptors_;
+        std::unique_ptr<std::atomic<int>[]> active_;
+        std::atomic<bool> running_{false};
+        std::atomic<uint64_t> requests_{0};
+        std::atomic<uint64_t> bytes_{0};
+
+        std::mutex mutex_;
+        std::condition_variable idle_;
+        int connections_ = 0;
+
+};
+
+#endif
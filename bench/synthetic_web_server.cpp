@@ -0,0 +1,45 @@
+#include "synthetic_web.hpp"
+#include <iostream>
+
+// Standalone synthetic web, e.g. for crawl_bench --connect or for poking at with curl:
+//   synthetic_web_server --hosts 8 --pages 5000 --base-port 18000 --max-latency-ms 50 --seconds 600
+
+int main(int argc, char** argv) {
+
+    SyntheticWebConfig config;
+    int seconds = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        int used = SyntheticWebUtils::parseConfigArg(config, argc, argv, i);
+        if (used > 0) {
+            i += used - 1;
+        }
+        else if (std::string(argv[i]) == "--seconds" && i + 1 < argc) {
+            seconds = std::atoi(argv[++i]);
+        }
+        else {
+            std::cerr << "unknown argument: " << argv[i] << '\n';
+            return 2;
+        }
+    }
+
+    SyntheticWebServer server(config);
+    if (!server.start()) {
+        std::cerr << "failed to start synthetic web server\n";
+        return 1;
+    }
+
+    for (int h = 0; h < config.hosts; ++h) {
+        std::cout << "host " << h << ": " << server.hostUrl(h) << '\n';
+    }
+    std::cout << (seconds > 0 ? "serving for " + std::to_string(seconds) + "s" : std::string("serving until killed")) << std::endl;
+
+    auto start = std::chrono::steady_clock::now();
+    while (seconds <= 0 || std::chrono::steady_clock::now() - start < std::chrono::seconds(seconds)) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+
+    std::cout << "served " << server.requestsServed() << " requests, " << server.bytesServed() << " bytes\n";
+    server.stop();
+    return 0;
+}
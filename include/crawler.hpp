@@ -1,18 +1,550 @@
 #ifndef CRAWLER_HPP
 #define CRAWLER_HPP
 
+#include "downloader.hpp"
+#include "parser.hpp"
+#include "url.hpp"
+#include "sitemap.hpp"
+#include "link_graph.hpp"
+#include "inverted_index.hpp"
+#include <algorithm>
 #include <string>
+#include <vector>
+#include <queue>
+#include <unordered_set>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+
+
+struct CrawlStats {
+    uint64_t pages_fetched = 0;
+    uint64_t pages_ok = 0;
+    uint64_t pages_failed = 0;
+    uint64_t bytes = 0;
+    uint64_t links_found = 0;
+    uint64_t urls_queued = 0;
+    uint64_t retries = 0;
+};
+
 
 class Crawler {
 
     public:
 
+        static Crawler& instance(Downloader& downloader) {
+            static Crawler crawler(downloader);
+            return crawler;
+        }
+
+        Crawler(const Crawler&) = delete;
+        Crawler& operator=(const Crawler&) = delete;
+
+        void setMaxPages(size_t n) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            max_pages_ = n;
+        }
+
+        // Upper bound on fetches handed to the pool at once, so the frontier order still matters
+        void setMaxInFlight(size_t n) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            max_in_flight_ = n == 0 ? 1 : n;
+        }
+
+        // How often a throttled (429/503) or timed out URL is put back in the frontier
+        void setMaxRetries(int n) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            max_retries_ = n < 0 ? 0 : n;
+        }
+
+        // Only follow links to hosts that were seeded
+        void setSeedHostsOnly(bool only) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            seed_hosts_only_ = only;
+        }
+
+        void seed(const std::string& url, double priority = 1.0) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            seed_hosts_.insert(UrlUtils::host(url));
+            pushLocked(UrlUtils::stripFragment(url), priority, 0);
+        }
+
+        // At most every this many fetched pages, and once enough new links are logged (see
+        // LinkGraph::compactionDue), the link graph is compacted and re-ranked in a pool task and
+        // the frontier re-prioritized by the new scores; 0 keeps recording links but never re-ranks
+        void setRankInterval(size_t pages) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            rank_interval_ = pages;
+            next_rank_at_ = stats_.pages_fetched + pages;
+        }
+
+        LinkGraph& graph() {
+            return graph_;
+        }
+
+        // Optional full-text stage: every HTML or plain-text page fetched with a 2xx is indexed
+        // in its own pool task after link extraction. The index must outlive the crawl; nullptr turns it off.
+        void setIndex(InvertedIndex* index) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            index_ = index;
+        }
+
+        // Bulk seeding, e.g. with SitemapLoader batches: one lock and one wake-up per batch.
+        // Priorities come from the entries' <priority> and <lastmod>. Returns how many were new.
+        size_t seedBatch(const std::vector<SitemapEntry>& entries) {
+            size_t added = 0;
+            const long today = SitemapUtils::todayDays();
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                for (const auto& e : entries) {
+                    if (!UrlUtils::isHttp(e.loc)) {
+                        continue;
+                    }
+                    const std::string host = UrlUtils::host(e.loc);
+                    seed_hosts_.insert(host);
+                    if (pushLocked(UrlUtils::stripFragment(e.loc), host, SitemapUtils::seedPriority(e, today), 0)) {
+                        ++added;
+                    }
+                }
+            }
+            cv_.notify_all();
+            return added;
+        }
+
+        // Blocks until the frontier is drained, max pages is reached or stop() is called.
+        // Hosts are served in frontier priority order, but only while the Downloader's
+        // HostController grants them a slot, so capacity drifts toward responsive hosts.
+        void run() {
+
+            std::unique_lock<std::mutex> lock(mutex_);
+            stop_ = false;
+
+            while (true) {
 
+                std::vector<std::string> blocked;
+
+                while (!stop_ && !ready_.empty() && in_flight_.size() < max_in_flight_ && dispatched_ < max_pages_) {
+
+                    HostEntry h = ready_.top();
+                    ready_.pop();
+
+                    auto it = host_queues_.find(h.host);
+                    if (it == host_queues_.end()) {
+                        continue;
+                    }
+                    HostQueue& q = it->second;
+                    if (!q.scheduled || q.urls.empty() || h.priority != q.scheduled_priority) {
+                        continue; // stale entry, a fresher one is in the heap
+                    }
+                    q.scheduled = false;
+
+                    if (dispatchLocked(h.host, q) == 0) {
+                        blocked.push_back(h.host);
+                        if (downloader_.pool().stopped()) {
+                            // refused for good, not throttled: nothing will wake this loop to retry
+                            stop_ = true;
+                        }
+                        continue;
+                    }
+                    scheduleLocked(h.host, q);
+                }
+
+                for (const auto& host : blocked) {
+                    scheduleLocked(host, host_queues_[host]);
+                }
+
+                if (rank_ready_) {
+                    rank_ready_ = false;
+                    rescoreLocked();
+                    continue;
+                }
+
+                if (rank_interval_ > 0 && !ranking_ && !stop_ && stats_.pages_fetched >= next_rank_at_ &&
+                    graph_.compactionDue()) {
+                    next_rank_at_ = stats_.pages_fetched + rank_interval_;
+                    startRankLocked();
+                }
+
+                const bool exhausted = stop_ || frontier_size_ == 0 || dispatched_ >= max_pages_;
+                if (in_flight_.empty() && exhausted) {
+                    // the graph is left settled for callers of graph()
+                    cv_.wait(lock, [this]() { return !ranking_; });
+                    rank_ready_ = false;
+                    break;
+                }
+
+                const auto resume = downloader_.hosts().nextResume();
+                if (blocked.empty() || resume == std::chrono::steady_clock::time_point::max()) {
+                    cv_.wait(lock);
+                }
+                else {
+                    cv_.wait_until(lock, resume);
+                }
+            }
+        }
+
+        void stop() {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stop_ = true;
+            }
+            cv_.notify_all();
+        }
+
+        CrawlStats stats() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return stats_;
+        }
+
+        static std::vector<std::string> extractLinks(const std::string& base_url, std::string_view body) {
+
+            std::vector<std::string> links;
+            std::string base = base_url;
+
+            HtmlTokenizer tokenizer(body);
+            HtmlToken token;
+            while (tokenizer.next(token)) {
+                if (token.type != TokenType::StartTag) {
+                    continue;
+                }
+                if (token.name == "base") {
+                    std::string href = decodeAmp(token.attribute("href"));
+                    if (!href.empty()) {
+                        std::string resolved = UrlUtils::resolve(base_url, href);
+                        if (!resolved.empty()) {
+                            base = resolved;
+                        }
+                    }
+                }
+                else if (token.name == "a" || token.name == "area") {
+                    std::string_view href = token.attribute("href");
+                    if (href.empty()) {
+                        continue;
+                    }
+                    std::string resolved = UrlUtils::resolve(base, decodeAmp(href));
+                    if (!resolved.empty()) {
+                        links.push_back(std::move(resolved));
+                    }
+                }
+            }
+            return links;
+        }
 
     private:
 
+        // priority is base (seed or sitemap priority, decayed per hop) times the link-rank boost
+        struct FrontierEntry {
+            double priority;
+            uint64_t seq;
+            std::string url;
+            int attempts;
+            double base;
+            uint64_t fp;
+
+            bool operator<(const FrontierEntry& other) const {
+                if (priority != other.priority) {
+                    return priority < other.priority;
+                }
+                return seq > other.seq;
+            }
+        };
+
+        // Exposes the heap storage so rescoreLocked() can re-weight entries in place
+        struct FrontierQueue : std::priority_queue<FrontierEntry> {
+            std::vector<FrontierEntry>& entries() {
+                return c;
+            }
+
+            void reheap() {
+                std::make_heap(c.begin(), c.end(), comp);
+            }
+        };
+
+        struct HostQueue {
+            FrontierQueue urls;
+            double scheduled_priority = 0.0;
+            bool scheduled = false;
+        };
+
+        // One entry per host with queued URLs, ordered by the best URL it holds
+        struct HostEntry {
+            double priority;
+            uint64_t seq;
+            std::string host;
+
+            bool operator<(const HostEntry& other) const {
+                if (priority != other.priority) {
+                    return priority < other.priority;
+                }
+                return seq > other.seq;
+            }
+        };
+
+        struct InFlight {
+            double base;
+            int attempts;
+        };
+
+        Crawler(Downloader& downloader) : downloader_(downloader) {
+            downloader_.setPageHandler([this](const FetchResult& result, const PageRef& page) {
+                onPage(result, page);
+            });
+        }
+
+        static std::string decodeAmp(std::string_view s) {
+            std::string out;
+            out.reserve(s.size());
+            for (size_t i = 0; i < s.size(); ++i) {
+                if (s[i] == '&' && s.compare(i, 5, "&amp;") == 0) {
+                    out.push_back('&');
+                    i += 4;
+                }
+                else {
+                    out.push_back(s[i]);
+                }
+            }
+            return out;
+        }
+
+        bool pushLocked(std::string url, double base, int attempts) {
+            const std::string host = UrlUtils::host(url);
+            return pushLocked(std::move(url), host, base, attempts);
+        }
+
+        bool pushLocked(std::string url, const std::string& host, double base, int attempts) {
+            const uint64_t fp = UrlUtils::fingerprint(url);
+            if (attempts == 0 && !seen_.insert(fp).second) {
+                return false;
+            }
+            HostQueue& q = host_queues_[host];
+            if (q.urls.empty()) {
+                // a host (re)entering the frontier is resolved while its URLs wait their turn
+                downloader_.prefetch(url);
+            }
+            q.urls.push(FrontierEntry{base * rankBoost(graph_.score(fp)), seq_++, std::move(url), attempts, base, fp});
+            ++frontier_size_;
+            if (attempts == 0) {
+                ++stats_.urls_queued;
+            }
+            scheduleLocked(host, q);
+            return true;
+        }
+
+        // Hands the host's best URL to the Downloader, or in HTTP/2 mode a batch of its best
+        // URLs to be multiplexed over one connection (a single URL until the host has shown it
+        // speaks HTTP/2). Returns how many were dispatched.
+        size_t dispatchLocked(const std::string& host, HostQueue& q) {
+
+            if (!downloader_.http2()) {
+                const FrontierEntry& e = q.urls.top();
+                if (!downloader_.tryEnqueue(e.url)) {
+                    return 0;
+                }
+                markDispatchedLocked(e);
+                q.urls.pop();
+                return 1;
+            }
+
+            std::vector<FrontierEntry> taken;
+            std::vector<std::string> urls;
+            size_t fresh = 0;
+            const size_t streams = downloader_.batchLimit(host);
+            while (!q.urls.empty() && taken.size() < streams &&
+                   in_flight_.size() + taken.size() < max_in_flight_) {
+                const FrontierEntry& e = q.urls.top();
+                if (e.attempts == 0) {
+                    if (dispatched_ + fresh >= max_pages_) {
+                        break;
+                    }
+                    ++fresh;
+                }
+                taken.push_back(e);
+                urls.push_back(e.url);
+                q.urls.pop();
+            }
+
+            const size_t n = downloader_.tryEnqueueBatch(urls);
+            for (size_t i = 0; i < taken.size(); ++i) {
+                if (i < n) {
+                    markDispatchedLocked(taken[i]);
+                }
+                else {
+                    q.urls.push(std::move(taken[i]));
+                }
+            }
+            return n;
+        }
+
+        void markDispatchedLocked(const FrontierEntry& e) {
+            in_flight_.emplace(e.url, InFlight{e.base, e.attempts});
+            if (e.attempts == 0) {
+                ++dispatched_;
+            }
+            --frontier_size_;
+        }
+
+        // Scores are relative to the mean page, so an average page doubles its base priority and
+        // a page nobody links to yet keeps about its base
+        static double rankBoost(double score) {
+            return 1.0 + std::log2(1.0 + score);
+        }
+
+        // Re-prioritizes every queued URL with the current link scores and rebuilds the host heap.
+        // Scores are fetched in one call so the graph is locked once, not once per URL.
+        void rescoreLocked() {
+            rescore_fps_.clear();
+            for (auto& kv : host_queues_) {
+                for (const auto& e : kv.second.urls.entries()) {
+                    rescore_fps_.push_back(e.fp);
+                }
+            }
+            graph_.scores(rescore_fps_, rescore_scores_);
+
+            ready_ = std::priority_queue<HostEntry>();
+            size_t i = 0;
+            for (auto& kv : host_queues_) {
+                HostQueue& q = kv.second;
+                for (auto& e : q.urls.entries()) {
+                    e.priority = e.base * rankBoost(rescore_scores_[i++]);
+                }
+                q.urls.reheap();
+                q.scheduled = false;
+                scheduleLocked(kv.first, q);
+            }
+        }
+
+        // Compacts and ranks the graph in a pool task, so fetches and link parsing go on meanwhile;
+        // run() re-prioritizes the frontier once the new scores are published
+        void startRankLocked() {
+            ThreadPool& pool = downloader_.pool();
+            std::function<void()> task = [this, &pool]() {
+                graph_.compact();
+                graph_.rank(&pool);
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    ranking_ = false;
+                    rank_ready_ = true;
+                }
+                cv_.notify_all();
+            };
+            ranking_ = pool.enqueue(std::move(task));
+        }
+
+        void scheduleLocked(const std::string& host, HostQueue& q) {
+            if (q.urls.empty()) {
+                return;
+            }
+            const double top = q.urls.top().priority;
+            if (!q.scheduled || top > q.scheduled_priority) {
+                ready_.push(HostEntry{top, seq_++, host});
+                q.scheduled = true;
+                q.scheduled_priority = top;
+            }
+        }
+
+        void onPage(const FetchResult& result, const PageRef& page) {
+
+            std::vector<std::string> links;
+            if (result.ok() && !page.empty()) {
+                links = extractLinks(result.final_url, page.view());
+            }
+            std::vector<uint64_t> targets;
+            targets.reserve(links.size());
+            InvertedIndex* index = nullptr;
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+
+                index = index_;
+
+                InFlight job{1.0, 0};
+                auto it = in_flight_.find(result.url);
+                if (it != in_flight_.end()) {
+                    job = it->second;
+                    in_flight_.erase(it);
+                }
+
+                const bool retryable = result.code == CURLE_OPERATION_TIMEDOUT ||
+                                       result.status == 429 || result.status == 503;
+                if (retryable && job.attempts < max_retries_) {
+                    ++stats_.retries;
+                    pushLocked(result.url, job.base, job.attempts + 1);
+                }
+
+                ++stats_.pages_fetched;
+                if (result.ok()) {
+                    ++stats_.pages_ok;
+                }
+                else {
+                    ++stats_.pages_failed;
+                }
+                stats_.bytes += page.size();
+                stats_.links_found += links.size();
+
+                // redirect targets count as seen so they are not fetched twice
+                if (result.final_url != result.url) {
+                    seen_.insert(UrlUtils::fingerprint(result.final_url));
+                }
+
+                for (auto& link : links) {
+                    std::string host = UrlUtils::host(link);
+                    if (seed_hosts_only_ && seed_hosts_.count(host) == 0) {
+                        continue;
+                    }
+                    targets.push_back(UrlUtils::fingerprint(link));
+                    pushLocked(std::move(link), host, job.base * link_decay_, 0);
+                }
+            }
+
+            if (!targets.empty()) {
+                graph_.addEdges(UrlUtils::fingerprint(result.url), targets);
+            }
+
+            // images, PDFs and archives would only fill the index with junk terms
+            if (index && result.ok() && !page.empty() && EncodingUtils::isDocumentType(result.content_type, page.view())) {
+                std::function<void()> task = [index, url = result.final_url, page]() {
+                    index->addDocument(url, page.view());
+                };
+                if (!downloader_.pool().enqueue(std::move(task))) {
+                    task();
+                }
+            }
+
+            cv_.notify_all();
+        }
+
+        Downloader& downloader_;
+
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        std::unordered_map<std::string, HostQueue> host_queues_;
+        std::priority_queue<HostEntry> ready_;
+        size_t frontier_size_ = 0;
+        std::unordered_set<uint64_t> seen_;
+        std::unordered_set<std::string> seed_hosts_;
+        std::unordered_map<std::string, InFlight> in_flight_;
+        CrawlStats stats_;
+        LinkGraph graph_;
+        std::vector<uint64_t> rescore_fps_;       // scratch for rescoreLocked()
+        std::vector<double> rescore_scores_;
+        InvertedIndex* index_ = nullptr;
 
+        uint64_t seq_ = 0;
+        size_t dispatched_ = 0;
+        size_t max_pages_ = static_cast<size_t>(-1);
+        size_t max_in_flight_ = 64;
+        size_t rank_interval_ = 2000;
+        uint64_t next_rank_at_ = 2000;
+        double link_decay_ = 0.9;
+        int max_retries_ = 3;
+        bool seed_hosts_only_ = true;
+        bool stop_ = false;
+        bool ranking_ = false;      // a rank task is queued or running
+        bool rank_ready_ = false;   // it published scores the frontier has not seen yet
 
 };
 
-#endif
\ No newline at end of file
+#endif
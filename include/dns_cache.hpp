@@ -0,0 +1,336 @@
+#ifndef DNS_CACHE_HPP
+#define DNS_CACHE_HPP
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#endif
+
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+// What a resolver returns; no addresses means the name does not resolve
+struct DnsAnswer {
+    std::vector<std::string> addresses;
+    int ttl_seconds = -1;   // -1 when the resolver cannot tell (getaddrinfo), the cache default applies
+};
+
+struct DnsStats {
+    uint64_t lookups = 0;         // resolve() calls
+    uint64_t hits = 0;            // answered from a fresh entry
+    uint64_t negative_hits = 0;   // answered from a fresh "does not resolve" entry
+    uint64_t joined = 0;          // waited for a resolution already running
+    uint64_t misses = 0;          // resolved in the calling thread
+    uint64_t expired = 0;         // misses on an entry past its TTL
+    uint64_t prefetches = 0;      // background resolutions queued
+    uint64_t resolutions = 0;     // resolver calls finished
+    uint64_t failures = 0;        // of which returned no address
+    double resolve_ms = 0.0;      // total time spent in the resolver
+    size_t entries = 0;
+
+    // Share of lookups that did not wait for the resolver
+    double hitRate() const {
+        return lookups ? static_cast<double>(hits + negative_hits) / lookups : 0.0;
+    }
+
+    double meanResolveMs() const {
+        return resolutions ? resolve_ms / resolutions : 0.0;
+    }
+};
+
+
+namespace DnsUtils {
+
+    // IPv4 dotted quad or IPv6 literal (bracketed or not); those are never looked up
+    inline bool isIpLiteral(const std::string& host) {
+        if (host.empty()) {
+            return false;
+        }
+        if (host.front() == '[' || host.find(':') != std::string::npos) {
+            return true;
+        }
+        return std::all_of(host.begin(), host.end(), [](char c) { return (c >= '0' && c <= '9') || c == '.'; });
+    }
+
+    // The system resolver. getaddrinfo does not report TTLs, so the cache's default applies.
+    inline DnsAnswer systemResolve(const std::string& host) {
+        DnsAnswer answer;
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* result = nullptr;
+        if (getaddrinfo(host.c_str(), nullptr, &hints, &result) != 0) {
+            return answer;
+        }
+        for (addrinfo* ai = result; ai; ai = ai->ai_next) {
+            char text[INET6_ADDRSTRLEN] = {0};
+            if (ai->ai_family == AF_INET) {
+                inet_ntop(AF_INET, &reinterpret_cast<sockaddr_in*>(ai->ai_addr)->sin_addr, text, sizeof(text));
+            }
+            else if (ai->ai_family == AF_INET6) {
+                inet_ntop(AF_INET6, &reinterpret_cast<sockaddr_in6*>(ai->ai_addr)->sin6_addr, text, sizeof(text));
+            }
+            else {
+                continue;
+            }
+            if (text[0] && std::find(answer.addresses.begin(), answer.addresses.end(), text) == answer.addresses.end()) {
+                answer.addresses.emplace_back(text);
+            }
+        }
+        freeaddrinfo(result);
+        return answer;
+    }
+
+}
+
+
+// Host name cache shared by all fetches. prefetch() resolves in the background on a small
+// pool of its own, so names are usually known before their first fetch; resolve() answers
+// from the cache, joins a resolution already running, or resolves in the calling thread.
+// Entries live for the answer's TTL (clamped), failed names for the negative TTL.
+class DnsCache {
+
+    public:
+
+        using Resolver = std::function<DnsAnswer(const std::string& host)>;
+
+        DnsCache() : resolver_(DnsUtils::systemResolve) {}
+
+        ~DnsCache() {
+            stop();
+        }
+
+        DnsCache(const DnsCache&) = delete;
+        DnsCache& operator=(const DnsCache&) = delete;
+
+        // Set these before the first lookup
+        void setResolver(Resolver resolver) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            resolver_ = std::move(resolver);
+        }
+
+        void setThreads(int n) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            threads_ = std::max(1, n);
+        }
+
+        void setTtl(int default_seconds, int min_seconds, int max_seconds) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            default_ttl_ = std::chrono::seconds(default_seconds);
+            min_ttl_ = std::chrono::seconds(min_seconds);
+            max_ttl_ = std::chrono::seconds(std::max(min_seconds, max_seconds));
+        }
+
+        void setNegativeTtl(int seconds) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            negative_ttl_ = std::chrono::seconds(seconds);
+        }
+
+        void setMaxEntries(size_t n) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            max_entries_ = std::max<size_t>(1, n);
+        }
+
+        // Queues a background resolution unless the entry is fresh or one is running already.
+        // Never blocks on the resolver; returns whether anything was queued.
+        bool prefetch(const std::string& host) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (stopped_) {
+                    return false;
+                }
+                Entry& e = entries_[host];
+                if (e.pending || freshLocked(e, std::chrono::steady_clock::now())) {
+                    return false;
+                }
+                e.pending = true;
+                ++stats_.prefetches;
+                if (!started_) {
+                    started_ = true;
+                    pool_.start(threads_);
+                }
+            }
+            if (!pool_.enqueue([this, host]() { run(host); })) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                entries_[host].pending = false;
+                cv_.notify_all();
+                return false;
+            }
+            return true;
+        }
+
+        // Fills addresses and returns true if host resolves, false if it does not
+        bool resolve(const std::string& host, std::vector<std::string>& addresses) {
+
+            std::unique_lock<std::mutex> lock(mutex_);
+            ++stats_.lookups;
+            Entry* e = &entries_[host];
+            const auto now = std::chrono::steady_clock::now();
+
+            if (freshLocked(*e, now)) {
+                ++(e->negative ? stats_.negative_hits : stats_.hits);
+                addresses = e->addresses;
+                return !e->negative;
+            }
+
+            if (e->pending) {
+                ++stats_.joined;
+                cv_.wait(lock, [&]() {
+                    e = &entries_[host];
+                    return !e->pending;
+                });
+                if (e->resolved) {
+                    addresses = e->addresses;
+                    return !e->negative && !addresses.empty();
+                }
+                // evicted before this thread woke up; resolve it here, counted as joined only
+            }
+            else {
+                ++stats_.misses;
+            }
+
+            if (e->resolved) {
+                ++stats_.expired;
+            }
+            e->pending = true;
+            lock.unlock();
+            addresses = run(host);
+            return !addresses.empty();
+        }
+
+        DnsStats stats() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            DnsStats s = stats_;
+            s.entries = entries_.size();
+            return s;
+        }
+
+        // Waits for queued prefetches; later prefetch() calls are ignored
+        void stop() {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (stopped_) {
+                    return;
+                }
+                stopped_ = true;
+            }
+            pool_.stop();
+        }
+
+    private:
+
+        struct Entry {
+            std::vector<std::string> addresses;
+            std::chrono::steady_clock::time_point expires;
+            bool negative = false;
+            bool resolved = false;    // has held an answer
+            bool pending = false;
+        };
+
+        bool freshLocked(const Entry& e, std::chrono::steady_clock::time_point now) const {
+            return e.resolved && now < e.expires;
+        }
+
+        // Returns the addresses stored for host, empty if it does not resolve
+        std::vector<std::string> run(const std::string& host) {
+
+            Resolver resolver;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                resolver = resolver_;
+            }
+
+            const auto started = std::chrono::steady_clock::now();
+            DnsAnswer answer = resolver(host);
+            const auto now = std::chrono::steady_clock::now();
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++stats_.resolutions;
+            stats_.resolve_ms += std::chrono::duration<double, std::milli>(now - started).count();
+
+            Entry& e = entries_[host];
+            e.pending = false;
+            e.resolved = true;
+            e.negative = answer.addresses.empty();
+            if (e.negative) {
+                ++stats_.failures;
+                e.addresses.clear();
+                e.expires = now + negative_ttl_;
+            }
+            else {
+                std::chrono::seconds ttl = answer.ttl_seconds < 0 ? default_ttl_ : std::chrono::seconds(answer.ttl_seconds);
+                ttl = std::min(max_ttl_, std::max(min_ttl_, ttl));
+                e.addresses = std::move(answer.addresses);
+                e.expires = now + ttl;
+            }
+            std::vector<std::string> addresses = e.addresses;
+
+            if (entries_.size() > max_entries_) {
+                evictLocked(now, host);
+            }
+            cv_.notify_all();
+            return addresses;
+        }
+
+        // Expired entries first; if that is not enough, any settled ones down to 90%.
+        // keep (the entry just written) and pending entries always stay.
+        void evictLocked(std::chrono::steady_clock::time_point now, const std::string& keep) {
+            for (auto it = entries_.begin(); it != entries_.end();) {
+                if (!it->second.pending && !freshLocked(it->second, now) && it->first != keep) {
+                    it = entries_.erase(it);
+                }
+                else {
+                    ++it;
+                }
+            }
+            const size_t target = max_entries_ - max_entries_ / 10;
+            for (auto it = entries_.begin(); it != entries_.end() && entries_.size() > target;) {
+                if (!it->second.pending && it->first != keep) {
+                    it = entries_.erase(it);
+                }
+                else {
+                    ++it;
+                }
+            }
+        }
+
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        std::unordered_map<std::string, Entry> entries_;
+        DnsStats stats_;
+        Resolver resolver_;
+
+        ThreadPool pool_;
+        int threads_ = 2;
+        bool started_ = false;
+        bool stopped_ = false;
+
+        std::chrono::seconds default_ttl_{300};
+        std::chrono::seconds min_ttl_{5};
+        std::chrono::seconds max_ttl_{3600};
+        std::chrono::seconds negative_ttl_{30};
+        size_t max_entries_ = 100000;
+
+};
+
+#endif
\ No newline at end of file
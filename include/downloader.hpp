@@ -2,7 +2,14 @@
 #define DOWNLOADER_HPP
 
 #include "thread_pool.hpp"
+#include "tracer.hpp"
+#include "host_controller.hpp"
+#include "url.hpp"
+#include "page_buffer.hpp"
+#include "encoding.hpp"
+#include "dns_cache.hpp"
 #include <curl/curl.h>
+#include <chrono>
 #include <fstream>
 #include <string>
 #include <queue>
@@ -11,6 +18,22 @@
 #include <sstream>
 #include <iomanip>
 #include <functional>
+#include <memory>
+#include <vector>
+
+
+struct FetchResult {
+    std::string url;
+    std::string final_url; // after redirects
+    long status = 0;
+    CURLcode code = CURLE_OK;
+    std::string content_type;
+    std::string charset;   // what the body was decoded from, empty if it was not decoded
+
+    bool ok() const {
+        return code == CURLE_OK && status >= 200 && status < 300;
+    }
+};
 
 
 class Downloader {
@@ -36,48 +59,488 @@ class Downloader {
 
         void enqueue(const std::string& website) {
 
-            pool_.enqueue(std::bind(&Downloader::download, this, website));
+            const std::string host = UrlUtils::host(website);
+            hosts_.acquire(host);
+            prefetch(website);
+            if (!pool_.enqueue(std::bind(&Downloader::download, this, website, std::chrono::steady_clock::now()))) {
+                hosts_.cancel(host);
+            }
+
+        }
+
+        // Like enqueue, but only if the host's controller has a free slot; used by schedulers
+        bool tryEnqueue(const std::string& website) {
+
+            const std::string host = UrlUtils::host(website);
+            if (!hosts_.tryAcquire(host)) {
+                return false;
+            }
+            prefetch(website);
+            if (!pool_.enqueue(std::bind(&Downloader::download, this, website, std::chrono::steady_clock::now()))) {
+                hosts_.cancel(host);
+                return false;
+            }
+            return true;
+
+        }
+
+        // Dispatches up to batchLimit() same-host URLs as one multiplexed task. Stops at the
+        // first URL the host controller refuses; returns how many were taken.
+        size_t tryEnqueueBatch(const std::vector<std::string>& websites) {
+
+            if (websites.empty()) {
+                return 0;
+            }
+            const std::string host = UrlUtils::host(websites.front());
+            const size_t limit = batchLimit(host);
+            std::vector<std::string> batch;
+            for (const auto& w : websites) {
+                if (batch.size() >= limit || !hosts_.tryAcquire(host)) {
+                    break;
+                }
+                batch.push_back(w);
+            }
+            if (batch.empty()) {
+                return 0;
+            }
+            prefetch(batch.front());
+            const size_t n = batch.size();
+            auto now = std::chrono::steady_clock::now();
+            if (!pool_.enqueue([this, batch = std::move(batch), now]() { downloadBatch(batch, now); })) {
+                for (size_t i = 0; i < n; ++i) {
+                    hosts_.cancel(host);
+                }
+                return 0;
+            }
+            return n;
+
+        }
+
+        // HTTP/2 mode: negotiate h2 over TLS (h2c is not attempted) and let schedulers
+        // batch same-host URLs onto one connection via tryEnqueueBatch
+        void setHttp2(bool enabled) {
+            http2_ = enabled;
+        }
+
+        bool http2() const {
+            return http2_;
+        }
+
+        // Cap on a whole transfer, body included (default 120 s). Connects and stalls are cut
+        // much earlier, by the host's adaptive timeout.
+        void setTransferTimeoutMs(long ms) {
+            transfer_timeout_ms_ = ms < 1 ? 1 : ms;
+        }
+
+        // Concurrent streams per host connection, also the largest batch
+        void setMaxStreamsPerHost(long n) {
+            max_streams_ = n < 1 ? 1 : n;
+        }
+
+        long maxStreamsPerHost() const {
+            return max_streams_;
+        }
+
+        // Largest batch worth sending to host: maxStreamsPerHost() once it has answered over
+        // HTTP/2, otherwise one, since an HTTP/1.1 host would serve the batch serially on one
+        // connection while the batch holds all its slots
+        size_t batchLimit(const std::string& host) {
+            return hosts_.multiplexes(host) ? static_cast<size_t>(max_streams_) : 1;
+        }
+
+        // Accept-Encoding with every decoder the bundled curl has (brotli, zstd, gzip)
+        void setCompression(bool enabled) {
+            compression_ = enabled;
+        }
 
+        // Text bodies reach the page handler as UTF-8, whatever charset they were served in
+        void setTextDecoding(bool enabled) {
+            decode_text_ = enabled;
+        }
+
+        // Host names are resolved through dns() and handed to curl with CURLOPT_RESOLVE, so a
+        // fetch of a cached host skips resolution; names that do not resolve fail without a
+        // transfer. Off, curl resolves every fetch itself.
+        void setDnsCache(bool enabled) {
+            dns_enabled_ = enabled;
+        }
+
+        // Resolve hosts in the background when their URLs are queued (by the crawler frontier
+        // or enqueue), ahead of the fetch
+        void setDnsPrefetch(bool enabled) {
+            dns_prefetch_ = enabled;
+        }
+
+        // Starts resolving the URL's host unless it is cached, in flight or an IP literal
+        void prefetch(const std::string& url) {
+            if (dns_enabled_ && dns_prefetch_) {
+                const std::string name = UrlUtils::hostname(url);
+                if (!DnsUtils::isIpLiteral(name)) {
+                    dns_.prefetch(name);
+                }
+            }
+        }
+
+        DnsCache& dns() {
+            return dns_;
+        }
+
+        ThreadPool& pool() {
+            return pool_;
+        }
+
+        const std::string& userAgent() const {
+            return user_agent_;
+        }
+
+        const std::string& caPath() const {
+            return ca_path_str_;
+        }
+
+        HostController& hosts() {
+            return hosts_;
+        }
+
+        // Page bodies live in pooled slabs; stats() shows occupancy and reuse
+        PageBufferPool& pages() {
+            return pages_;
+        }
+
+        // Runs as its own pool task after every fetch, failed ones included (with an empty page).
+        // The page is shared with the storage task, not copied, unless it had to be converted to
+        // UTF-8 (see setTextDecoding); keep a PageRef to hold on to it.
+        // Set it before the first enqueue.
+        using PageHandler = std::function<void(const FetchResult& result, const PageRef& page)>;
+
+        void setPageHandler(PageHandler handler) {
+            handler_ = std::move(handler);
         }
 
     private:
 
+        // One fetch in progress; shared by the single-request and the multiplexed path
+        struct Transfer {
+            std::string url;
+            std::string host;
+            PageRef page;
+            CURL* curl = nullptr;
+            curl_slist* resolve = nullptr;   // cached addresses for CURLOPT_RESOLVE
+            bool unresolved = false;         // the host is cached as not resolving
+            bool traced = false;
+            FetchTrace trace;
+        };
+
         static size_t writeCallback(void* contents, size_t size, size_t nmemb, void* userp) {
             size_t totalSize = size * nmemb;
-            std::string* body = static_cast<std::string*>(userp);
-            body->append((char*)contents, totalSize);
+            PageRef* page = static_cast<PageRef*>(userp);
+            page->append(static_cast<const char*>(contents), totalSize);
             return totalSize;
         }
 
-        void download(const std::string& website) {
+        void begin(Transfer& t, const std::string& website, std::chrono::steady_clock::time_point enqueued) {
+
+            t.url = website;
+            t.host = UrlUtils::host(website);
+            t.page = pages_.acquire();
 
-            CURL* curl;
-            CURLcode res;
-            std::string response;
+            t.traced = Tracer::instance().shouldTrace();
+            if (t.traced) {
+                t.trace.enqueued = enqueued;
+                t.trace.started = std::chrono::steady_clock::now();
+            }
 
-            curl = curl_easy_init();
+            t.curl = curl_easy_init();
 
-            if (curl) {
-                curl_easy_setopt(curl, CURLOPT_URL, website.c_str());
+            if (t.curl) {
+                CURL* curl = t.curl;
+                curl_easy_setopt(curl, CURLOPT_URL, t.url.c_str());
                 curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeCallback);
-                curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+                curl_easy_setopt(curl, CURLOPT_WRITEDATA, &t.page);
                 curl_easy_setopt(curl, CURLOPT_CAINFO, ca_path_str_.c_str());
                 curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-                curl_easy_setopt(curl, CURLOPT_TIMEOUT, 20L);
+                // the host's adaptive timeout comes from its first-byte latency, so it bounds the
+                // connect and any stretch without data; the whole transfer gets a generous cap
+                const long stall_ms = hosts_.timeoutMs(t.host);
+                curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, stall_ms);
+                curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 1L);
+                curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, std::max(1L, (stall_ms + 999) / 1000));
+                curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, transfer_timeout_ms_);
                 curl_easy_setopt(curl, CURLOPT_USERAGENT, user_agent_.c_str());
+                if (http2_) {
+                    // otherwise libcurl's own default applies (2TLS in current releases)
+                    curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+                }
+                if (compression_) {
+                    // "" offers every encoding this libcurl can decode (gzip, deflate, br, zstd)
+                    curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");
+                }
+                if (dns_enabled_) {
+                    resolve(t);
+                }
+            }
+        }
 
-                res = curl_easy_perform(curl);
+        void resolve(Transfer& t) {
+            const std::string name = UrlUtils::hostname(t.url);
+            if (name.empty() || DnsUtils::isIpLiteral(name)) {
+                return;
+            }
+            std::vector<std::string> addresses;
+            if (!dns_.resolve(name, addresses)) {
+                t.unresolved = true;
+                return;
+            }
+            std::string entry = name + ':' + std::to_string(UrlUtils::port(t.url)) + ':';
+            for (size_t i = 0; i < addresses.size(); ++i) {
+                if (i) {
+                    entry += ',';
+                }
+                const bool v6 = addresses[i].find(':') != std::string::npos;
+                entry += v6 ? '[' + addresses[i] + ']' : addresses[i];
+            }
+            t.resolve = curl_slist_append(nullptr, entry.c_str());
+            if (t.resolve) {
+                curl_easy_setopt(t.curl, CURLOPT_RESOLVE, t.resolve);
+            }
+        }
+
+        void finish(Transfer& t, CURLcode res) {
+
+            FetchResult result;
+            result.url = t.url;
+            result.final_url = t.url;
+            result.code = CURLE_FAILED_INIT;
+
+            FetchOutcome outcome;
+            outcome.failed = true;
+
+            if (t.curl) {
+                CURL* curl = t.curl;
+
+                if (t.traced) {
+                    t.trace.transferred = std::chrono::steady_clock::now();
+                    fillTrace(curl, res, t.trace);
+                }
+
+                result.code = res;
+                curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &result.status);
+                char* final_url = nullptr;
+                if (curl_easy_getinfo(curl, CURLINFO_EFFECTIVE_URL, &final_url) == CURLE_OK && final_url) {
+                    result.final_url = final_url;
+                }
+                char* content_type = nullptr;
+                if (curl_easy_getinfo(curl, CURLINFO_CONTENT_TYPE, &content_type) == CURLE_OK && content_type) {
+                    result.content_type = content_type;
+                }
+
+                outcome = FetchOutcome();
+                outcome.status = result.status;
+                outcome.timed_out = res == CURLE_OPERATION_TIMEDOUT;
+                outcome.failed = res != CURLE_OK && !outcome.timed_out;
+                curl_off_t ttfb = 0;
+                if (curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &ttfb) == CURLE_OK) {
+                    outcome.latency_ms = ttfb / 1000.0;
+                }
+                curl_off_t retry_after = 0;
+                if (curl_easy_getinfo(curl, CURLINFO_RETRY_AFTER, &retry_after) == CURLE_OK) {
+                    outcome.retry_after_s = static_cast<long>(retry_after);
+                }
+
+                TransferCounters counters;
+                curl_off_t wire = 0;
+                if (curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &wire) == CURLE_OK) {
+                    counters.wire_bytes = static_cast<uint64_t>(wire);
+                }
+                long header_bytes = 0;
+                curl_easy_getinfo(curl, CURLINFO_HEADER_SIZE, &header_bytes);
+                counters.header_bytes = static_cast<uint64_t>(header_bytes);
+                counters.decoded_bytes = t.page.size();
+                long connects = 0;
+                curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &connects);
+                counters.new_connections = static_cast<uint64_t>(connects);
+                long version = 0;
+                curl_easy_getinfo(curl, CURLINFO_HTTP_VERSION, &version);
+                counters.http2 = version == CURL_HTTP_VERSION_2_0;
+                hosts_.recordTransfer(t.host, counters);
+
+                curl_easy_cleanup(curl);
+                t.curl = nullptr;
+                if (t.resolve) {
+                    curl_slist_free_all(t.resolve);
+                    t.resolve = nullptr;
+                }
+
+                if (t.traced) {
+                    t.trace.url = t.url;
+                    t.trace.threadId = std::this_thread::get_id();
+                }
 
                 if (res == CURLE_OK) {
-                    savePage(website, response);
+                    runTask([this, url = t.url, page = t.page, traced = t.traced, trace = std::move(t.trace)]() mutable {
+                        if (traced) {
+                            trace.saveThreadId = std::this_thread::get_id();
+                            trace.saving = std::chrono::steady_clock::now();
+                        }
+                        savePage(url, page);
+                        if (traced) {
+                            trace.stored = std::chrono::steady_clock::now();
+                            Tracer::instance().record(std::move(trace));
+                        }
+                    });
                 }
-                else{
+                else {
                     //use logger?
+                    t.page.reset();
+                    if (t.traced) {
+                        Tracer::instance().record(std::move(t.trace));
+                    }
                 }
+            }
+            else {
+                t.page.reset();
+            }
 
-                curl_easy_cleanup(curl);
+            hosts_.release(t.host, outcome);
+
+            if (handler_) {
+                runTask([this, result = std::move(result), page = std::move(t.page)]() mutable {
+                    // storage keeps the bytes as served; the handler always sees UTF-8 text
+                    if (decode_text_ && page && EncodingUtils::isTextType(result.content_type)) {
+                        const EncodingInfo info = EncodingUtils::detect(page.view(), result.content_type);
+                        result.charset = info.charset == Charset::Other ? info.label : EncodingUtils::name(info.charset);
+                        page = EncodingUtils::decodePage(page, info, pages_);
+                    }
+                    handler_(result, page);
+                });
+            }
+        }
+
+        void download(const std::string& website, std::chrono::steady_clock::time_point enqueued) {
+
+            Transfer t;
+            begin(t, website, enqueued);
+
+            CURLcode res = CURLE_FAILED_INIT;
+            if (t.unresolved) {
+                res = CURLE_COULDNT_RESOLVE_HOST;
+            }
+            else if (t.curl) {
+                res = curl_easy_perform(t.curl);
+            }
+
+            finish(t, res);
+
+        }
+
+        // Same-host URLs as concurrent streams of one multi handle. The handle lives as long
+        // as the worker thread, so its HTTP/2 connection is reused by the next batch too.
+        void downloadBatch(const std::vector<std::string>& websites, std::chrono::steady_clock::time_point enqueued) {
+
+            struct MultiHandle {
+                CURLM* multi = nullptr;
+                ~MultiHandle() {
+                    if (multi) {
+                        curl_multi_cleanup(multi);
+                    }
+                }
+            };
+            thread_local MultiHandle handle;
+
+            if (!handle.multi) {
+                handle.multi = curl_multi_init();
+                if (handle.multi) {
+                    curl_multi_setopt(handle.multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+                    curl_multi_setopt(handle.multi, CURLMOPT_MAX_HOST_CONNECTIONS, 1L);
+                }
+            }
+            if (!handle.multi) {
+                for (const auto& w : websites) {
+                    download(w, enqueued);
+                }
+                return;
+            }
+            CURLM* multi = handle.multi;
+            curl_multi_setopt(multi, CURLMOPT_MAX_CONCURRENT_STREAMS, max_streams_);
+
+            std::vector<std::unique_ptr<Transfer>> transfers;
+            transfers.reserve(websites.size());
+            size_t pending = 0;
+
+            for (const auto& w : websites) {
+                transfers.push_back(std::make_unique<Transfer>());
+                Transfer& t = *transfers.back();
+                begin(t, w, enqueued);
+                if (!t.curl || t.unresolved) {
+                    finish(t, t.curl ? CURLE_COULDNT_RESOLVE_HOST : CURLE_FAILED_INIT);
+                    continue;
+                }
+                // wait for the shared connection instead of opening one per stream
+                curl_easy_setopt(t.curl, CURLOPT_PIPEWAIT, 1L);
+                curl_easy_setopt(t.curl, CURLOPT_PRIVATE, &t);
+                if (curl_multi_add_handle(multi, t.curl) != CURLM_OK) {
+                    finish(t, CURLE_FAILED_INIT);
+                    continue;
+                }
+                ++pending;
             }
 
+            int running = 0;
+            while (pending > 0) {
+                if (curl_multi_perform(multi, &running) != CURLM_OK) {
+                    break;
+                }
+
+                int left = 0;
+                while (CURLMsg* msg = curl_multi_info_read(multi, &left)) {
+                    if (msg->msg != CURLMSG_DONE) {
+                        continue;
+                    }
+                    Transfer* t = nullptr;
+                    curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &t);
+                    CURLcode res = msg->data.result;
+                    curl_multi_remove_handle(multi, msg->easy_handle);
+                    finish(*t, res);
+                    --pending;
+                }
+
+                if (pending > 0 && running > 0) {
+                    curl_multi_poll(multi, nullptr, 0, 1000, nullptr);
+                }
+            }
+
+            // only reached with handles left on a multi error
+            for (auto& t : transfers) {
+                if (t->curl) {
+                    curl_multi_remove_handle(multi, t->curl);
+                    finish(*t, CURLE_RECV_ERROR);
+                }
+            }
+
+        }
+
+        // Pipeline stages go back on the pool; once it is shutting down they run inline.
+        // enqueue() only moves the task out when it accepts it.
+        template<typename F>
+        void runTask(F&& f) {
+            std::function<void()> task(std::forward<F>(f));
+            if (!pool_.enqueue(std::move(task))) {
+                task();
+            }
+        }
+
+        static void fillTrace(CURL* curl, CURLcode res, FetchTrace& trace) {
+            curl_off_t t = 0;
+            if (curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME_T, &t) == CURLE_OK) trace.namelookup_us = t;
+            if (curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &t) == CURLE_OK) trace.connect_us = t;
+            if (curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME_T, &t) == CURLE_OK) trace.appconnect_us = t;
+            if (curl_easy_getinfo(curl, CURLINFO_PRETRANSFER_TIME_T, &t) == CURLE_OK) trace.pretransfer_us = t;
+            if (curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &t) == CURLE_OK) trace.starttransfer_us = t;
+            if (curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &t) == CURLE_OK) trace.total_us = t;
+            if (curl_easy_getinfo(curl, CURLINFO_REDIRECT_TIME_T, &t) == CURLE_OK) trace.redirect_us = t;
+            long status = 0;
+            curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+            trace.status = status;
+            trace.result = static_cast<int>(res);
         }
 
         static std::string toShortHex(std::size_t h) {
@@ -86,6 +549,8 @@ class Downloader {
             return ss.str();
         }
 
+    public:
+
         static std::string sanitizeComponent(const std::string& in) {
             std::string out;
             out.reserve(in.size());
@@ -212,9 +677,11 @@ class Downloader {
             filename += ".html";
             return filename;
         }
-        
 
-        void savePage(const std::string& website, const std::string& response){
+    private:
+
+
+        void savePage(const std::string& website, const PageRef& page){
             //To do: sqlite, json?
 
             const std::string filename = urlToFilename(website);
@@ -236,7 +703,7 @@ class Downloader {
                 return;
             }
 
-            ofs.write(response.data(), static_cast<std::streamsize>(response.size()));
+            ofs.write(page.data(), static_cast<std::streamsize>(page.size()));
 
             ofs.close();
         }
@@ -253,6 +720,17 @@ class Downloader {
         std::string ca_path_str_;
         std::string download_dir_;
         std::string user_agent_;
+        PageHandler handler_;
+        HostController hosts_;
+        PageBufferPool pages_;
+        bool http2_ = false;
+        bool compression_ = true;
+        bool decode_text_ = true;
+        DnsCache dns_;
+        bool dns_enabled_ = true;
+        bool dns_prefetch_ = true;
+        long max_streams_ = 16;
+        long transfer_timeout_ms_ = 120000;
 
 };
 
@@ -0,0 +1,525 @@
+#ifndef ENCODING_HPP
+#define ENCODING_HPP
+
+#include "parser.hpp"
+#include "page_buffer.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ENCODING_SSE2 1
+#endif
+
+// Legacy multi-byte charsets (Shift_JIS, GBK, EUC-KR, ...) go through the platform converter
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#define ENCODING_WINAPI 1
+#elif __has_include(<iconv.h>)
+#include <iconv.h>
+#define ENCODING_ICONV 1
+#endif
+
+
+// Windows1252 also covers ISO-8859-1 and US-ASCII labels, as browsers do
+enum class Charset { Unknown, Utf8, Utf16LE, Utf16BE, Windows1252, ShiftJis, Other };
+
+enum class EncodingSource { Bom, Header, Meta, Sniffed };
+
+struct EncodingInfo {
+    Charset charset = Charset::Utf8;
+    std::string label;       // lower-cased label as declared, for Other
+    EncodingSource source = EncodingSource::Sniffed;
+    size_t bom = 0;          // bytes of byte order mark to skip
+    bool valid_utf8 = false; // the whole body was already validated as UTF-8 (sniffed)
+};
+
+
+namespace EncodingUtils {
+
+    inline int firstSetBit(unsigned v) {
+#if defined(_MSC_VER)
+        unsigned long i;
+        _BitScanForward(&i, v);
+        return static_cast<int>(i);
+#else
+        return __builtin_ctz(v);
+#endif
+    }
+
+    // Length of the leading run of ASCII bytes, 16 at a time where SSE2 is available
+    inline size_t asciiPrefix(const char* p, size_t n) {
+        size_t i = 0;
+#ifdef ENCODING_SSE2
+        for (; i + 16 <= n; i += 16) {
+            const int mask = _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i)));
+            if (mask) {
+                return i + firstSetBit(static_cast<unsigned>(mask));
+            }
+        }
+#else
+        for (; i + 8 <= n; i += 8) {
+            uint64_t word;
+            std::memcpy(&word, p + i, 8);
+            if (word & 0x8080808080808080ull) {
+                break;
+            }
+        }
+#endif
+        while (i < n && !(static_cast<unsigned char>(p[i]) & 0x80)) {
+            ++i;
+        }
+        return i;
+    }
+
+    // Length of the well-formed UTF-8 sequence at s (Unicode table 3-7: no overlongs, no
+    // surrogates, nothing past U+10FFFF), 0 if it is not one
+    inline size_t sequenceLength(const unsigned char* s, size_t n) {
+        const unsigned c = s[0];
+        if (c < 0x80) {
+            return 1;
+        }
+        if (c < 0xC2) {
+            return 0;
+        }
+        if (c < 0xE0) {
+            return (n >= 2 && (s[1] & 0xC0) == 0x80) ? 2 : 0;
+        }
+        if (c < 0xF0) {
+            const unsigned lo = c == 0xE0 ? 0xA0 : 0x80;
+            const unsigned hi = c == 0xED ? 0x9F : 0xBF;
+            return (n >= 3 && s[1] >= lo && s[1] <= hi && (s[2] & 0xC0) == 0x80) ? 3 : 0;
+        }
+        if (c < 0xF5) {
+            const unsigned lo = c == 0xF0 ? 0x90 : 0x80;
+            const unsigned hi = c == 0xF4 ? 0x8F : 0xBF;
+            return (n >= 4 && s[1] >= lo && s[1] <= hi && (s[2] & 0xC0) == 0x80 && (s[3] & 0xC0) == 0x80) ? 4 : 0;
+        }
+        return 0;
+    }
+
+    // Bytes of the longest valid UTF-8 prefix; equal to n for valid input
+    inline size_t validUtf8Prefix(const char* p, size_t n) {
+        const unsigned char* s = reinterpret_cast<const unsigned char*>(p);
+        size_t i = 0;
+        while (i < n) {
+            i += asciiPrefix(p + i, n - i);
+            // text in a non-Latin script is mostly multi-byte, stay in the scalar loop for it
+            while (i < n && s[i] >= 0x80) {
+                const size_t len = sequenceLength(s + i, n - i);
+                if (!len) {
+                    return i;
+                }
+                i += len;
+            }
+        }
+        return n;
+    }
+
+    inline bool isValidUtf8(std::string_view s) {
+        return validUtf8Prefix(s.data(), s.size()) == s.size();
+    }
+
+    using ParserUtils::appendCodePoint;
+
+    // Copies UTF-8, replacing each maximal ill-formed subpart with U+FFFD
+    template<typename Out>
+    void repairUtf8(std::string_view in, Out& out) {
+        const unsigned char* s = reinterpret_cast<const unsigned char*>(in.data());
+        const size_t n = in.size();
+        size_t i = 0;
+        while (i < n) {
+            const size_t good = validUtf8Prefix(in.data() + i, n - i);
+            out.append(in.data() + i, good);
+            i += good;
+            if (i >= n) {
+                break;
+            }
+            // the bad lead byte plus any continuation bytes that still fit its pattern
+            size_t skip = 1;
+            const unsigned c = s[i];
+            const size_t expected = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC2 ? 2 : 1;
+            if (c >= 0xC2 && c < 0xF5) {
+                unsigned lo = 0x80, hi = 0xBF;
+                if (c == 0xE0) lo = 0xA0;
+                if (c == 0xED) hi = 0x9F;
+                if (c == 0xF0) lo = 0x90;
+                if (c == 0xF4) hi = 0x8F;
+                while (skip < expected && i + skip < n && s[i + skip] >= lo && s[i + skip] <= hi) {
+                    ++skip;
+                    lo = 0x80;
+                    hi = 0xBF;
+                }
+            }
+            appendCodePoint(out, 0xFFFD);
+            i += skip;
+        }
+    }
+
+    // UTF-8 for bytes 0x80..0x9F of windows-1252; the rest of the upper half is Latin-1
+    struct HighByte {
+        char bytes[3];
+        uint8_t len;
+    };
+
+    inline const HighByte* windows1252Table() {
+        static const HighByte* table = [] {
+            static HighByte t[128];
+            for (int b = 0x80; b < 0x100; ++b) {
+                const uint32_t cp = b < 0xA0 ? ParserUtils::windows1252C1()[b - 0x80] : static_cast<uint32_t>(b);
+                struct {
+                    HighByte* h;
+                    void append(const char* p, size_t n) {
+                        std::memcpy(h->bytes, p, n);
+                        h->len = static_cast<uint8_t>(n);
+                    }
+                } sink{&t[b - 0x80]};
+                appendCodePoint(sink, cp);
+            }
+            return t;
+        }();
+        return table;
+    }
+
+    template<typename Out>
+    void windows1252ToUtf8(std::string_view in, Out& out) {
+        const HighByte* table = windows1252Table();
+        size_t i = 0;
+        while (i < in.size()) {
+            const size_t run = asciiPrefix(in.data() + i, in.size() - i);
+            out.append(in.data() + i, run);
+            i += run;
+            while (i < in.size() && static_cast<unsigned char>(in[i]) >= 0x80) {
+                const HighByte& h = table[static_cast<unsigned char>(in[i]) - 0x80];
+                out.append(h.bytes, h.len);
+                ++i;
+            }
+        }
+    }
+
+    template<typename Out>
+    void utf16ToUtf8(std::string_view in, bool big_endian, Out& out) {
+        const unsigned char* s = reinterpret_cast<const unsigned char*>(in.data());
+        const size_t n = in.size() & ~static_cast<size_t>(1);
+        auto unit = [&](size_t i) -> uint32_t {
+            return big_endian ? (s[i] << 8 | s[i + 1]) : (s[i + 1] << 8 | s[i]);
+        };
+        for (size_t i = 0; i < n; i += 2) {
+            uint32_t cp = unit(i);
+            if (cp >= 0xD800 && cp <= 0xDBFF && i + 3 < n) {
+                const uint32_t lo = unit(i + 2);
+                if (lo >= 0xDC00 && lo <= 0xDFFF) {
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                    i += 2;
+                }
+            }
+            if (cp >= 0xD800 && cp <= 0xDFFF) {
+                cp = 0xFFFD; // unpaired surrogate
+            }
+            appendCodePoint(out, cp);
+        }
+        if (in.size() & 1) {
+            appendCodePoint(out, 0xFFFD);
+        }
+    }
+
+    inline std::string normalizeLabel(std::string_view label) {
+        std::string out;
+        for (char c : label) {
+            if (c == '"' || c == '\'' || ParserUtils::isSpace(c)) {
+                continue;
+            }
+            out.push_back(ParserUtils::toLower(c));
+        }
+        return out;
+    }
+
+    inline Charset charsetFromLabel(std::string_view raw) {
+        const std::string label = normalizeLabel(raw);
+        if (label.empty()) {
+            return Charset::Unknown;
+        }
+        if (label == "utf-8" || label == "utf8" || label == "unicode-1-1-utf-8") {
+            return Charset::Utf8;
+        }
+        if (label == "windows-1252" || label == "cp1252" || label == "x-cp1252" || label == "iso-8859-1" ||
+            label == "iso8859-1" || label == "latin1" || label == "l1" || label == "us-ascii" ||
+            label == "ascii" || label == "iso_8859-1" || label == "cp819" || label == "ibm819") {
+            return Charset::Windows1252;
+        }
+        if (label == "shift_jis" || label == "shift-jis" || label == "sjis" || label == "ms_kanji" ||
+            label == "windows-31j" || label == "x-sjis" || label == "csshiftjis" || label == "ms932") {
+            return Charset::ShiftJis;
+        }
+        if (label == "utf-16le" || label == "utf-16") {
+            return Charset::Utf16LE;
+        }
+        if (label == "utf-16be") {
+            return Charset::Utf16BE;
+        }
+        return Charset::Other;
+    }
+
+    inline const char* name(Charset c) {
+        switch (c) {
+            case Charset::Utf8: return "utf-8";
+            case Charset::Utf16LE: return "utf-16le";
+            case Charset::Utf16BE: return "utf-16be";
+            case Charset::Windows1252: return "windows-1252";
+            case Charset::ShiftJis: return "shift_jis";
+            case Charset::Other: return "other";
+            default: return "unknown";
+        }
+    }
+
+    // charset parameter of a Content-Type header value, empty if there is none
+    inline std::string_view charsetParam(std::string_view content_type) {
+        size_t p = 0;
+        while ((p = content_type.find(';', p)) != std::string_view::npos) {
+            ++p;
+            while (p < content_type.size() && ParserUtils::isSpace(content_type[p])) {
+                ++p;
+            }
+            if (content_type.size() - p > 8 && ParserUtils::iequals(content_type.substr(p, 8), "charset=")) {
+                std::string_view v = content_type.substr(p + 8);
+                size_t end = v.find(';');
+                return v.substr(0, end);
+            }
+        }
+        return {};
+    }
+
+    // Media types worth decoding as text
+    inline bool isTextType(std::string_view content_type) {
+        if (content_type.empty()) {
+            return true;
+        }
+        std::string_view type = content_type.substr(0, content_type.find(';'));
+        auto startsWith = [&](std::string_view prefix) {
+            return type.size() >= prefix.size() && ParserUtils::iequals(type.substr(0, prefix.size()), prefix);
+        };
+        auto endsWith = [&](std::string_view suffix) {
+            return type.size() >= suffix.size() && ParserUtils::iequals(type.substr(type.size() - suffix.size()), suffix);
+        };
+        return startsWith("text/") || endsWith("xml") || endsWith("+json") || endsWith("/json") ||
+               endsWith("javascript");
+    }
+
+    // What is worth full-text indexing: HTML, XHTML and plain text. Without a Content-Type the
+    // body counts as text unless its first bytes hold a NUL, as binary formats nearly always do.
+    inline bool isDocumentType(std::string_view content_type, std::string_view body) {
+        std::string_view type = content_type.substr(0, content_type.find(';'));
+        while (!type.empty() && (type.back() == ' ' || type.back() == '\t')) {
+            type.remove_suffix(1);
+        }
+        if (type.empty()) {
+            return body.substr(0, 512).find('\0') == std::string_view::npos;
+        }
+        return ParserUtils::iequals(type, "text/html") || ParserUtils::iequals(type, "application/xhtml+xml") ||
+               ParserUtils::iequals(type, "text/plain");
+    }
+
+    inline size_t bomLength(std::string_view body, Charset& charset) {
+        const unsigned char* s = reinterpret_cast<const unsigned char*>(body.data());
+        if (body.size() >= 3 && s[0] == 0xEF && s[1] == 0xBB && s[2] == 0xBF) {
+            charset = Charset::Utf8;
+            return 3;
+        }
+        if (body.size() >= 2 && s[0] == 0xFF && s[1] == 0xFE) {
+            charset = Charset::Utf16LE;
+            return 2;
+        }
+        if (body.size() >= 2 && s[0] == 0xFE && s[1] == 0xFF) {
+            charset = Charset::Utf16BE;
+            return 2;
+        }
+        return 0;
+    }
+
+    // <meta charset> or <meta http-equiv="content-type" content="...; charset=..."> within
+    // the first 1024 bytes, as browsers prescan
+    inline std::string metaCharset(std::string_view body) {
+        HtmlTokenizer tokenizer(body.substr(0, 1024));
+        HtmlToken token;
+        while (tokenizer.next(token)) {
+            if (token.type != TokenType::StartTag || token.name != "meta") {
+                continue;
+            }
+            std::string_view cs = token.attribute("charset");
+            if (!cs.empty()) {
+                return std::string(cs);
+            }
+            if (ParserUtils::iequals(token.attribute("http-equiv"), "content-type")) {
+                cs = charsetParam(token.attribute("content"));
+                if (!cs.empty()) {
+                    return std::string(cs);
+                }
+            }
+        }
+        return {};
+    }
+
+    // BOM, then the Content-Type charset, then <meta>; without any of them the body is
+    // taken as UTF-8 if it validates and as windows-1252 otherwise
+    inline EncodingInfo detect(std::string_view body, std::string_view content_type) {
+
+        EncodingInfo info;
+        Charset c = Charset::Unknown;
+
+        if ((info.bom = bomLength(body, c)) > 0) {
+            info.charset = c;
+            info.source = EncodingSource::Bom;
+            return info;
+        }
+
+        std::string_view header = charsetParam(content_type);
+        c = charsetFromLabel(header);
+        if (c != Charset::Unknown) {
+            info.charset = c;
+            info.label = normalizeLabel(header);
+            info.source = EncodingSource::Header;
+            return info;
+        }
+
+        const std::string meta = metaCharset(body);
+        c = charsetFromLabel(meta);
+        if (c != Charset::Unknown) {
+            // a page cannot announce UTF-16 from inside itself, it was read as ASCII to get here
+            if (c == Charset::Utf16LE || c == Charset::Utf16BE) {
+                c = Charset::Utf8;
+            }
+            info.charset = c;
+            info.label = normalizeLabel(meta);
+            info.source = EncodingSource::Meta;
+            return info;
+        }
+
+        info.valid_utf8 = isValidUtf8(body);
+        info.charset = info.valid_utf8 ? Charset::Utf8 : Charset::Windows1252;
+        info.source = EncodingSource::Sniffed;
+        return info;
+    }
+
+    // Anything the platform converter knows, e.g. shift_jis, euc-jp, gbk, big5, euc-kr.
+    // Returns false if the charset is not available.
+    template<typename Out>
+    bool platformToUtf8(std::string_view in, const std::string& label, Out& out) {
+#if defined(ENCODING_ICONV)
+        iconv_t cd = iconv_open("UTF-8", label.c_str());
+        if (cd == reinterpret_cast<iconv_t>(-1)) {
+            return false;
+        }
+        char buffer[16 * 1024];
+        char* src = const_cast<char*>(in.data());
+        size_t left = in.size();
+        while (left > 0) {
+            char* dst = buffer;
+            size_t room = sizeof(buffer);
+            const size_t rc = iconv(cd, &src, &left, &dst, &room);
+            out.append(buffer, static_cast<size_t>(dst - buffer));
+            if (rc == static_cast<size_t>(-1)) {
+                if (errno == E2BIG) {
+                    continue;
+                }
+                // invalid or truncated input: one replacement character per bad byte
+                appendCodePoint(out, 0xFFFD);
+                ++src;
+                --left;
+                iconv(cd, nullptr, nullptr, nullptr, nullptr);
+            }
+        }
+        iconv_close(cd);
+        return true;
+#elif defined(ENCODING_WINAPI)
+        static const struct { const char* label; UINT page; } pages[] = {
+            {"shift_jis", 932}, {"shift-jis", 932}, {"sjis", 932}, {"ms_kanji", 932}, {"windows-31j", 932},
+            {"x-sjis", 932}, {"csshiftjis", 932}, {"ms932", 932}, {"euc-jp", 20932}, {"gbk", 936},
+            {"gb2312", 936}, {"big5", 950}, {"euc-kr", 949}, {"koi8-r", 20866}, {"windows-1250", 1250},
+            {"windows-1251", 1251}, {"windows-1253", 1253}, {"windows-1254", 1254}, {"windows-1255", 1255},
+            {"windows-1256", 1256}, {"iso-8859-2", 28592}, {"iso-8859-5", 28595}, {"iso-8859-15", 28605}
+        };
+        UINT page = 0;
+        for (const auto& p : pages) {
+            if (label == p.label) {
+                page = p.page;
+                break;
+            }
+        }
+        if (page == 0 || in.empty()) {
+            return page != 0;
+        }
+        const int src_len = static_cast<int>(in.size());
+        const int wide_len = MultiByteToWideChar(page, 0, in.data(), src_len, nullptr, 0);
+        if (wide_len <= 0) {
+            return false;
+        }
+        std::wstring wide(static_cast<size_t>(wide_len), L'\0');
+        MultiByteToWideChar(page, 0, in.data(), src_len, &wide[0], wide_len);
+        const int utf8_len = WideCharToMultiByte(CP_UTF8, 0, wide.data(), wide_len, nullptr, 0, nullptr, nullptr);
+        std::string utf8(static_cast<size_t>(utf8_len), '\0');
+        WideCharToMultiByte(CP_UTF8, 0, wide.data(), wide_len, &utf8[0], utf8_len, nullptr, nullptr);
+        out.append(utf8.data(), utf8.size());
+        return true;
+#else
+        (void)in;
+        (void)label;
+        (void)out;
+        return false;
+#endif
+    }
+
+    // Converts the body to UTF-8 in one pass. Out needs append(const char*, size_t).
+    template<typename Out>
+    void toUtf8(std::string_view body, const EncodingInfo& info, Out& out) {
+        body.remove_prefix(std::min(info.bom, body.size()));
+        switch (info.charset) {
+            case Charset::Windows1252:
+                windows1252ToUtf8(body, out);
+                return;
+            case Charset::Utf16LE:
+            case Charset::Utf16BE:
+                utf16ToUtf8(body, info.charset == Charset::Utf16BE, out);
+                return;
+            case Charset::ShiftJis:
+                if (platformToUtf8(body, "shift_jis", out)) {
+                    return;
+                }
+                break;
+            case Charset::Other:
+                if (platformToUtf8(body, info.label, out)) {
+                    return;
+                }
+                break;
+            default:
+                break;
+        }
+        // UTF-8, or a charset this build cannot convert: keep what is valid
+        repairUtf8(body, out);
+    }
+
+    // The encoding stage for fetched pages. Valid UTF-8 without a BOM is handed back as the
+    // same page (validation only, no copy); anything else is converted into a pooled page.
+    inline PageRef decodePage(const PageRef& page, const EncodingInfo& info, PageBufferPool& pool) {
+        const std::string_view body = page.view();
+        // a sniffed page was validated by detect(), the common case needs no second pass
+        if (info.charset == Charset::Utf8 && info.bom == 0 && (info.valid_utf8 || isValidUtf8(body))) {
+            return page;
+        }
+        PageRef out = pool.acquire(body.size() + body.size() / 4);
+        toUtf8(body, info, out);
+        return out;
+    }
+
+}
+
+#endif
\ No newline at end of file
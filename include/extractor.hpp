@@ -0,0 +1,524 @@
+#ifndef EXTRACTOR_HPP
+#define EXTRACTOR_HPP
+
+#include "parser.hpp"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+// Reused from page to page: clear() keeps the string capacity
+struct ExtractedPage {
+    std::string title;
+    std::string description;
+    std::string text;           // main content, one block per line
+    size_t blocks = 0;
+    size_t content_blocks = 0;
+
+    void clear() {
+        title.clear();
+        description.clear();
+        text.clear();
+        blocks = 0;
+        content_blocks = 0;
+    }
+};
+
+
+namespace ExtractorUtils {
+
+    enum CharClass : uint8_t { Plain = 0, Space = 1, Amp = 2 };
+
+    inline const uint8_t* charClasses() {
+        static const auto table = [] {
+            struct { uint8_t c[256]; } t{};
+            for (int c : {' ', '\t', '\n', '\r', '\f'}) {
+                t.c[c] = Space;
+            }
+            t.c[static_cast<unsigned char>('&')] = Amp;
+            return t;
+        }();
+        return table.c;
+    }
+
+    enum class TagKind : uint8_t { Inline, Block, Heading, Boilerplate, Skip, Anchor, Break, Title, Meta };
+
+    inline TagKind tagKind(std::string_view name) {
+        switch (name.size()) {
+            case 1:
+                if (name == "p") return TagKind::Block;
+                if (name == "a") return TagKind::Anchor;
+                break;
+            case 2:
+                if (name[0] == 'h' && name[1] >= '1' && name[1] <= '6') return TagKind::Heading;
+                if (name == "li" || name == "td" || name == "th" || name == "tr" || name == "dd" ||
+                    name == "dt" || name == "ul" || name == "ol" || name == "dl" || name == "hr") return TagKind::Block;
+                if (name == "br") return TagKind::Break;
+                break;
+            case 3:
+                if (name == "div" || name == "pre") return TagKind::Block;
+                if (name == "nav") return TagKind::Boilerplate;
+                if (name == "svg") return TagKind::Skip;
+                break;
+            case 4:
+                if (name == "main" || name == "form") return TagKind::Block;
+                if (name == "meta") return TagKind::Meta;
+                break;
+            case 5:
+                if (name == "table") return TagKind::Block;
+                if (name == "title") return TagKind::Title;
+                if (name == "aside") return TagKind::Boilerplate;
+                if (name == "style") return TagKind::Skip;
+                break;
+            case 6:
+                if (name == "header" || name == "figure" || name == "center") return TagKind::Block;
+                if (name == "footer") return TagKind::Boilerplate;
+                if (name == "script" || name == "select" || name == "button" || name == "iframe") return TagKind::Skip;
+                break;
+            case 7:
+                if (name == "article" || name == "section" || name == "address" || name == "details") return TagKind::Block;
+                break;
+            case 8:
+                if (name == "noscript" || name == "template" || name == "textarea") return TagKind::Skip;
+                if (name == "fieldset") return TagKind::Block;
+                break;
+            case 10:
+                if (name == "blockquote" || name == "figcaption") return TagKind::Block;
+                break;
+            default:
+                break;
+        }
+        return TagKind::Inline;
+    }
+
+    // class/id/role values that mark page furniture. Each class is split into words on '-' and
+    // '_' and only whole words count, so "site-nav" hints but "unavailable" and "promotion" do
+    // not; a word like "no" or "has" ends the class, as in the "no-sidebar" layout classes.
+    inline bool boilerplateHint(std::string_view value) {
+        static const std::string_view words[] = {
+            "nav", "navbar", "navigation", "menu", "footer", "sidebar", "comment", "comments", "share",
+            "sharing", "social", "breadcrumb", "breadcrumbs", "related", "cookie", "cookies", "banner",
+            "promo", "promos", "advert", "adverts", "advertisement", "newsletter", "widget", "widgets"
+        };
+        static const std::string_view modifiers[] = {"no", "has", "with", "without", "hide", "show"};
+        const uint8_t* cls = charClasses();
+        size_t i = 0;
+        while (i < value.size()) {
+            size_t end = i;
+            while (end < value.size() && cls[static_cast<unsigned char>(value[end])] != Space &&
+                   value[end] != '-' && value[end] != '_') {
+                ++end;
+            }
+            const std::string_view word = value.substr(i, end - i);
+            bool modifier = false;
+            for (std::string_view m : modifiers) {
+                modifier = modifier || ParserUtils::iequals(word, m);
+            }
+            if (modifier) {
+                // skip to the next class
+                while (end < value.size() && cls[static_cast<unsigned char>(value[end])] != Space) {
+                    ++end;
+                }
+            }
+            else {
+                for (std::string_view w : words) {
+                    if (ParserUtils::iequals(word, w)) {
+                        return true;
+                    }
+                }
+            }
+            i = end + 1;
+        }
+        return false;
+    }
+
+    // Entity-decodes in and appends it with whitespace runs collapsed to one space, none before
+    // out[start]. space carries a pending separator across calls; returns the words started.
+    template<typename Out>
+    size_t appendCollapsed(std::string_view in, Out& out, size_t start, bool& space, bool& in_word) {
+        const uint8_t* cls = charClasses();
+        size_t words = 0;
+        size_t i = 0;
+        while (i < in.size()) {
+            const uint8_t c = cls[static_cast<unsigned char>(in[i])];
+            if (c == Space) {
+                space = true;
+                in_word = false;
+                ++i;
+                continue;
+            }
+            char utf8[4];
+            const char* run = in.data() + i;
+            size_t len = 0;
+            size_t spaces = 0;
+            if (c == Plain) {
+                // words separated by single spaces are already collapsed, copy them in one go
+                size_t j = i + 1;
+                while (j < in.size()) {
+                    const uint8_t k = cls[static_cast<unsigned char>(in[j])];
+                    if (k == Plain) {
+                        ++j;
+                    }
+                    else if (in[j] == ' ' && j + 1 < in.size() && cls[static_cast<unsigned char>(in[j + 1])] == Plain) {
+                        ++spaces;
+                        j += 2;
+                    }
+                    else {
+                        break;
+                    }
+                }
+                len = j - i;
+                i = j;
+            }
+            else {
+                const size_t used = ParserUtils::characterReference(in.substr(i), utf8, len);
+                if (!used) {
+                    len = 1;
+                    ++i;
+                }
+                else {
+                    i += used;
+                    run = utf8;
+                    if (len == 2 && static_cast<unsigned char>(utf8[0]) == 0xC2 &&
+                        static_cast<unsigned char>(utf8[1]) == 0xA0) {
+                        space = true;   // &nbsp;
+                        in_word = false;
+                        continue;
+                    }
+                }
+            }
+            if (space) {
+                if (out.size() > start) {
+                    out.push_back(' ');
+                }
+                space = false;
+            }
+            words += spaces + !in_word;
+            in_word = true;
+            out.append(run, len);
+        }
+        return words;
+    }
+
+}
+
+
+// Main-content extraction in the spirit of boilerpipe's density rules: one pass over the
+// tokens splits the page into text blocks (measuring words, wrapped-line text density and
+// link density as it goes), then each block is kept or dropped by comparing its densities
+// with its neighbours'. Keep one Extractor per thread; extract() reuses its buffers.
+class Extractor {
+
+    public:
+
+        Extractor() = default;
+
+        Extractor(const Extractor&) = delete;
+        Extractor& operator=(const Extractor&) = delete;
+
+        void extract(std::string_view html, ExtractedPage& out) {
+
+            out.clear();
+            text_.clear();
+            blocks_.clear();
+            open_depth_ = 0;
+            regions_.clear();
+            region_ = -1;
+            skip_depth_ = 0;
+            anchor_depth_ = 0;
+            heading_depth_ = 0;
+            startBlock();
+
+            bool in_title = false;
+            bool title_space = false;
+            bool title_word = false;
+            bool og_description = false;
+
+            HtmlTokenizer tokenizer(html);
+            while (tokenizer.next(token_)) {
+
+                if (token_.type == TokenType::Text) {
+                    if (in_title) {
+                        if (out.title.empty()) {
+                            ExtractorUtils::appendCollapsed(token_.text, out.title, 0, title_space, title_word);
+                        }
+                    }
+                    else if (!skip_depth_) {
+                        const size_t before = text_.size();
+                        words_ += ExtractorUtils::appendCollapsed(token_.text, text_, block_start_, space_, in_word_);
+                        if (anchor_depth_) {
+                            link_bytes_ += text_.size() - before;
+                        }
+                    }
+                    continue;
+                }
+
+                const bool start = token_.type == TokenType::StartTag;
+                if (!start && token_.type != TokenType::EndTag) {
+                    continue;
+                }
+
+                using ExtractorUtils::TagKind;
+                const TagKind kind = ExtractorUtils::tagKind(token_.name);
+                switch (kind) {
+                    case TagKind::Inline:
+                        break;
+                    case TagKind::Anchor:
+                        if (start) {
+                            anchor_depth_ += !token_.selfClosing;
+                        }
+                        else if (anchor_depth_) {
+                            --anchor_depth_;
+                        }
+                        break;
+                    case TagKind::Skip:
+                        if (start) {
+                            skip_depth_ += !token_.selfClosing;
+                        }
+                        else if (skip_depth_) {
+                            --skip_depth_;
+                        }
+                        break;
+                    case TagKind::Break:
+                        space_ = true;
+                        in_word_ = false;
+                        break;
+                    case TagKind::Title:
+                        in_title = start && !token_.selfClosing;
+                        break;
+                    case TagKind::Meta:
+                        if (start) {
+                            meta(out, og_description);
+                        }
+                        break;
+                    default:
+                        closeBlock();
+                        if (start) {
+                            if (!token_.selfClosing && token_.name != "hr") {
+                                open(kind);
+                            }
+                        }
+                        else {
+                            close();
+                        }
+                        break;
+                }
+            }
+            closeBlock();
+
+            classify();
+
+            for (const Block& b : blocks_) {
+                if (b.content) {
+                    out.text.append(text_, b.offset, b.length);
+                    out.text.push_back('\n');
+                    ++out.content_blocks;
+                }
+            }
+            out.blocks = blocks_.size();
+        }
+
+        // Blocks whose linked text exceeds this share are navigation
+        void setMaxLinkDensity(double d) {
+            max_link_density_ = d;
+        }
+
+    private:
+
+        struct Block {
+            size_t offset;
+            size_t length;
+            size_t words;
+            double text_density;    // words per 80-column line
+            double link_density;    // linked bytes / bytes
+            int region;             // innermost hinted element around it, -1 for none
+            bool heading;
+            bool hinted;            // inside nav/aside/footer or a furniture class, set by classify()
+            bool content;
+        };
+
+        struct Open {
+            std::string name;
+            bool hinted;
+            bool heading;
+            int outer_region;       // region_ before this element opened
+        };
+
+        // A hinted element and the text inside it
+        struct Region {
+            int parent;
+            bool by_class;          // hinted by class/id/role rather than by its tag
+            size_t words;
+            bool wrapper;
+        };
+
+        void startBlock() {
+            block_start_ = text_.size();
+            words_ = 0;
+            link_bytes_ = 0;
+            space_ = false;
+            in_word_ = false;
+        }
+
+        void closeBlock() {
+            const size_t length = text_.size() - block_start_;
+            if (length > 0) {
+                Block b;
+                b.offset = block_start_;
+                b.length = length;
+                b.words = words_;
+                // boilerpipe's wrapped-line density; a short block is a single line
+                b.text_density = length < 80 ? static_cast<double>(words_) : words_ * 80.0 / length;
+                b.link_density = static_cast<double>(link_bytes_) / length;
+                b.region = region_;
+                b.heading = heading_depth_ > 0;
+                b.hinted = false;
+                b.content = false;
+                blocks_.push_back(b);
+            }
+            startBlock();
+        }
+
+        void open(ExtractorUtils::TagKind kind) {
+            // <p> and <li> are often left open; a new one ends the previous sibling
+            if (open_depth_ && (token_.name == "p" || token_.name == "li" || token_.name == "dt" ||
+                                token_.name == "dd") && open_[open_depth_ - 1].name == token_.name) {
+                popTo(open_depth_ - 1);
+            }
+            if (open_depth_ == open_.size()) {
+                open_.emplace_back();
+            }
+            Open& o = open_[open_depth_++];
+            o.name.assign(token_.name);
+            o.heading = kind == ExtractorUtils::TagKind::Heading;
+            const bool by_tag = kind == ExtractorUtils::TagKind::Boilerplate;
+            o.hinted = by_tag ||
+                       ExtractorUtils::boilerplateHint(token_.attribute("class")) ||
+                       ExtractorUtils::boilerplateHint(token_.attribute("id")) ||
+                       ExtractorUtils::boilerplateHint(token_.attribute("role"));
+            o.outer_region = region_;
+            if (o.hinted) {
+                regions_.push_back(Region{region_, !by_tag, 0, false});
+                region_ = static_cast<int>(regions_.size()) - 1;
+            }
+            heading_depth_ += o.heading;
+        }
+
+        void close() {
+            for (size_t i = open_depth_; i > 0; --i) {
+                if (open_[i - 1].name == token_.name) {
+                    popTo(i - 1);
+                    return;
+                }
+            }
+        }
+
+        void popTo(size_t depth) {
+            while (open_depth_ > depth) {
+                const Open& o = open_[--open_depth_];
+                region_ = o.outer_region;
+                heading_depth_ -= o.heading;
+            }
+        }
+
+        void meta(ExtractedPage& out, bool& og_description) {
+            const std::string_view name = token_.attribute("name");
+            const std::string_view property = token_.attribute("property");
+            const bool plain = ParserUtils::iequals(name, "description");
+            const bool og = ParserUtils::iequals(property, "og:description");
+            // <meta name=description> wins over og:description
+            if ((plain && (out.description.empty() || og_description)) || (og && out.description.empty())) {
+                out.description.clear();
+                bool space = false;
+                bool in_word = false;
+                ExtractorUtils::appendCollapsed(token_.attribute("content"), out.description, 0, space, in_word);
+                og_description = !plain;
+            }
+        }
+
+        // A class hint on an element holding most of the page's text is a layout wrapper
+        // ("page-with-sidebar"), not furniture, so it does not veto the blocks inside it;
+        // a hint nested within still does. <nav>, <aside> and <footer> always count.
+        void resolveHints() {
+            size_t total = 0;
+            for (const Block& b : blocks_) {
+                if (b.link_density > max_link_density_) {
+                    continue;
+                }
+                total += b.words;
+                for (int r = b.region; r >= 0; r = regions_[r].parent) {
+                    regions_[r].words += b.words;
+                }
+            }
+            for (Region& r : regions_) {
+                r.wrapper = r.by_class && r.words * 2 > total;
+            }
+            for (Block& b : blocks_) {
+                for (int r = b.region; r >= 0 && !b.hinted; r = regions_[r].parent) {
+                    b.hinted = !regions_[r].wrapper;
+                }
+            }
+        }
+
+        // boilerpipe's DensityRulesClassifier, then headings that lead into kept text
+        void classify() {
+
+            resolveHints();
+
+            const Block none{0, 0, 0, 0.0, 0.0, -1, false, false, false};
+            for (size_t i = 0; i < blocks_.size(); ++i) {
+                Block& cur = blocks_[i];
+                const Block& prev = i > 0 ? blocks_[i - 1] : none;
+                const Block& next = i + 1 < blocks_.size() ? blocks_[i + 1] : none;
+
+                bool content = false;
+                if (cur.hinted || cur.link_density > max_link_density_) {
+                    content = false;
+                }
+                else if (prev.link_density <= 0.555) {
+                    if (cur.text_density <= 9) {
+                        content = next.text_density > 10 || prev.text_density > 4;
+                    }
+                    else {
+                        content = next.text_density != 0;
+                    }
+                }
+                else {
+                    content = next.text_density > 11;
+                }
+                cur.content = content;
+            }
+
+            for (size_t i = blocks_.size(); i-- > 0;) {
+                Block& cur = blocks_[i];
+                if (cur.heading && !cur.hinted && cur.link_density <= max_link_density_ &&
+                    i + 1 < blocks_.size() && blocks_[i + 1].content) {
+                    cur.content = true;
+                }
+            }
+        }
+
+        HtmlToken token_;
+        std::string text_;
+        std::vector<Block> blocks_;
+        std::vector<Open> open_;
+        size_t open_depth_ = 0;
+        std::vector<Region> regions_;
+        int region_ = -1;
+
+        size_t block_start_ = 0;
+        size_t words_ = 0;
+        size_t link_bytes_ = 0;
+        bool space_ = false;
+        bool in_word_ = false;
+
+        int heading_depth_ = 0;
+        int skip_depth_ = 0;
+        int anchor_depth_ = 0;
+
+        double max_link_density_ = 0.33;
+
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,251 @@
+#ifndef HOST_CONTROLLER_HPP
+#define HOST_CONTROLLER_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+
+struct HostState {
+    double limit = 0.0;              // concurrency window, grows additively and halves on congestion
+    int in_flight = 0;
+    double latency_ewma_ms = 0.0;
+    double latency_floor_ms = 0.0;   // best recent latency, the "flat" reference
+    long timeout_ms = 0;             // connect / stall timeout, scaled from first-byte latency; not a body cap
+    std::chrono::steady_clock::time_point resume_at{};
+    int consecutive_failures = 0;
+    uint64_t completed = 0;
+    uint64_t throttled = 0;          // 429 / 503
+    uint64_t timeouts = 0;
+    uint64_t errors = 0;             // other transport failures
+    std::chrono::steady_clock::time_point last_decrease{};
+    // transfer accounting, to see what compression and connection reuse save
+    uint64_t wire_bytes = 0;         // body bytes as received, before content decoding
+    uint64_t decoded_bytes = 0;
+    uint64_t header_bytes = 0;
+    uint64_t connections_opened = 0;
+    uint64_t http2_transfers = 0;
+};
+
+struct TransferCounters {
+    uint64_t wire_bytes = 0;
+    uint64_t decoded_bytes = 0;
+    uint64_t header_bytes = 0;
+    uint64_t new_connections = 0;
+    bool http2 = false;
+};
+
+struct FetchOutcome {
+    long status = 0;
+    bool timed_out = false;
+    bool failed = false;             // transport error other than a timeout
+    double latency_ms = 0.0;
+    long retry_after_s = 0;          // from Retry-After, 0 if absent
+};
+
+
+// AIMD controller per host. The Downloader reports every fetch; schedulers ask it
+// whether a host may take one more request right now.
+class HostController {
+
+    public:
+
+        HostController() = default;
+
+        HostController(const HostController&) = delete;
+        HostController& operator=(const HostController&) = delete;
+
+        void setLimits(double initial, double min_limit, double max_limit) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            min_limit_ = std::max(1.0, min_limit);
+            max_limit_ = std::max(min_limit_, max_limit);
+            initial_limit_ = std::min(max_limit_, std::max(min_limit_, initial));
+        }
+
+        // Bounds of the adaptive connect / stall timeout
+        void setTimeouts(long min_timeout_ms, long max_timeout_ms) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            min_timeout_ms_ = std::max(1L, min_timeout_ms);
+            max_timeout_ms_ = std::max(min_timeout_ms_, max_timeout_ms);
+        }
+
+        // Reserves a slot if the host is under its window and not backing off
+        bool tryAcquire(const std::string& host) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            HostState& s = stateLocked(host);
+            if (std::chrono::steady_clock::now() < s.resume_at) {
+                return false;
+            }
+            if (s.in_flight >= static_cast<int>(s.limit)) {
+                return false;
+            }
+            ++s.in_flight;
+            return true;
+        }
+
+        // Reserves a slot unconditionally (direct Downloader::enqueue calls)
+        void acquire(const std::string& host) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++stateLocked(host).in_flight;
+        }
+
+        // Gives back a slot that was acquired but never used
+        void cancel(const std::string& host) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            HostState& s = stateLocked(host);
+            if (s.in_flight > 0) {
+                --s.in_flight;
+            }
+        }
+
+        void release(const std::string& host, const FetchOutcome& outcome) {
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            HostState& s = stateLocked(host);
+            const auto now = std::chrono::steady_clock::now();
+
+            if (s.in_flight > 0) {
+                --s.in_flight;
+            }
+            ++s.completed;
+
+            const bool throttled = outcome.status == 429 || outcome.status == 503;
+
+            if (throttled || outcome.timed_out || outcome.failed) {
+
+                if (throttled) ++s.throttled;
+                else if (outcome.timed_out) ++s.timeouts;
+                else ++s.errors;
+
+                ++s.consecutive_failures;
+
+                // one multiplicative decrease per latency window, not one per failed request
+                const auto window = std::chrono::milliseconds(static_cast<long>(std::max(100.0, s.latency_ewma_ms)));
+                if (now - s.last_decrease > window) {
+                    s.limit = std::max(min_limit_, s.limit * 0.5);
+                    s.last_decrease = now;
+                }
+
+                if (throttled || outcome.timed_out) {
+                    std::chrono::milliseconds wait;
+                    if (outcome.retry_after_s > 0) {
+                        wait = std::chrono::seconds(std::min(outcome.retry_after_s, 3600L));
+                    }
+                    else {
+                        const int shift = std::min(s.consecutive_failures - 1, 7);
+                        wait = std::chrono::milliseconds(std::min<long>(base_backoff_ms_ << shift, max_backoff_ms_));
+                    }
+                    s.resume_at = std::max(s.resume_at, now + wait);
+                }
+
+                if (outcome.timed_out) {
+                    s.timeout_ms = std::min(max_timeout_ms_, s.timeout_ms * 2);
+                }
+                return;
+            }
+
+            s.consecutive_failures = 0;
+
+            if (outcome.latency_ms > 0.0) {
+                if (s.latency_ewma_ms <= 0.0) {
+                    s.latency_ewma_ms = outcome.latency_ms;
+                    s.latency_floor_ms = outcome.latency_ms;
+                }
+                else {
+                    s.latency_ewma_ms += (outcome.latency_ms - s.latency_ewma_ms) * 0.2;
+                    // the floor creeps back up so a single lucky sample does not pin it forever
+                    s.latency_floor_ms = std::min(outcome.latency_ms,
+                                                  s.latency_floor_ms + (s.latency_ewma_ms - s.latency_floor_ms) * 0.01);
+                }
+                s.timeout_ms = std::clamp(static_cast<long>(s.latency_ewma_ms * 8.0) + min_timeout_ms_,
+                                          min_timeout_ms_, max_timeout_ms_);
+            }
+
+            // additive increase (about +1 per window of requests) while latency stays flat
+            if (s.latency_ewma_ms <= s.latency_floor_ms * 1.5 + 1.0) {
+                s.limit = std::min(max_limit_, s.limit + 1.0 / std::max(1.0, s.limit));
+            }
+            else if (s.latency_ewma_ms > s.latency_floor_ms * 3.0 + 5.0) {
+                s.limit = std::max(min_limit_, s.limit - 1.0 / std::max(1.0, s.limit));
+            }
+        }
+
+        void recordTransfer(const std::string& host, const TransferCounters& c) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            HostState& s = stateLocked(host);
+            s.wire_bytes += c.wire_bytes;
+            s.decoded_bytes += c.decoded_bytes;
+            s.header_bytes += c.header_bytes;
+            s.connections_opened += c.new_connections;
+            if (c.http2) {
+                ++s.http2_transfers;
+            }
+        }
+
+        // Whether the host has answered over HTTP/2, i.e. can take several streams on one connection
+        bool multiplexes(const std::string& host) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = hosts_.find(host);
+            return it != hosts_.end() && it->second.http2_transfers > 0;
+        }
+
+        long timeoutMs(const std::string& host) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return stateLocked(host).timeout_ms;
+        }
+
+        // Earliest time a backing-off host becomes eligible again, or time_point::max() if none is
+        std::chrono::steady_clock::time_point nextResume() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            const auto now = std::chrono::steady_clock::now();
+            auto next = std::chrono::steady_clock::time_point::max();
+            for (const auto& kv : hosts_) {
+                if (kv.second.resume_at > now) {
+                    next = std::min(next, kv.second.resume_at);
+                }
+            }
+            return next;
+        }
+
+        HostState state(const std::string& host) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return stateLocked(host);
+        }
+
+        std::vector<std::pair<std::string, HostState>> snapshot() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return std::vector<std::pair<std::string, HostState>>(hosts_.begin(), hosts_.end());
+        }
+
+    private:
+
+        HostState& stateLocked(const std::string& host) {
+            auto it = hosts_.find(host);
+            if (it == hosts_.end()) {
+                HostState s;
+                s.limit = initial_limit_;
+                s.timeout_ms = max_timeout_ms_;
+                it = hosts_.emplace(host, s).first;
+            }
+            return it->second;
+        }
+
+        std::mutex mutex_;
+        std::unordered_map<std::string, HostState> hosts_;
+
+        double initial_limit_ = 2.0;
+        double min_limit_ = 1.0;
+        double max_limit_ = 32.0;
+        long min_timeout_ms_ = 2000;
+        long max_timeout_ms_ = 20000;
+        long base_backoff_ms_ = 500;
+        long max_backoff_ms_ = 60000;
+
+};
+
+#endif
@@ -0,0 +1,906 @@
+#ifndef INVERTED_INDEX_HPP
+#define INVERTED_INDEX_HPP
+
+#include "parser.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+
+struct IndexHit {
+    uint32_t doc = 0;
+    std::string url;
+    uint32_t score = 0;          // summed term frequencies
+};
+
+struct IndexStats {
+    uint64_t total_docs = 0;     // in the index, earlier sessions included
+    uint64_t docs = 0;           // added since the index was opened
+    uint64_t tokens = 0;
+    uint64_t text_bytes = 0;     // HTML bytes fed to addDocument
+    double index_seconds = 0.0;  // thread time spent in addDocument, summed over threads
+    double wall_seconds = 0.0;   // since the index was opened
+    size_t segments = 0;         // on disk
+    size_t pending_segments = 0; // in memory, including the one being filled
+    size_t unreadable_segments = 0; // listed in the manifest but failed to open, still listed
+    uint64_t flushes = 0;
+    uint64_t failed_flushes = 0;    // documents kept in memory only
+    uint64_t merges = 0;
+    uint64_t disk_bytes = 0;
+
+    // per thread of indexing work
+    double docsPerSec() const {
+        return index_seconds > 0.0 ? docs / index_seconds : 0.0;
+    }
+
+    double wallDocsPerSec() const {
+        return wall_seconds > 0.0 ? docs / wall_seconds : 0.0;
+    }
+};
+
+
+namespace IndexUtils {
+
+    inline void putVarint(std::string& out, uint64_t v) {
+        while (v >= 0x80) {
+            out.push_back(static_cast<char>(v | 0x80));
+            v >>= 7;
+        }
+        out.push_back(static_cast<char>(v));
+    }
+
+    // Returns false on a truncated value
+    inline bool getVarint(const char*& p, const char* end, uint64_t& v) {
+        v = 0;
+        int shift = 0;
+        while (p < end) {
+            const uint8_t b = static_cast<uint8_t>(*p++);
+            v |= static_cast<uint64_t>(b & 0x7F) << shift;
+            if (!(b & 0x80)) {
+                return true;
+            }
+            shift += 7;
+            if (shift > 63) {
+                return false;
+            }
+        }
+        return false;
+    }
+
+    inline bool isWordByte(unsigned char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c >= 0x80;
+    }
+
+    // Lower-cased ASCII alphanumeric runs; UTF-8 sequences are kept as part of a word.
+    // Character references such as "&amp;" or "&#39;" act as separators.
+    template<typename F>
+    void forEachTerm(std::string_view text, std::string& term, F&& emit) {
+        const size_t max_term = 64;
+        size_t i = 0;
+        while (i < text.size()) {
+            const unsigned char c = static_cast<unsigned char>(text[i]);
+            if (c == '&') {
+                size_t j = i + 1;
+                while (j < text.size() && j - i < 12 && (isWordByte(static_cast<unsigned char>(text[j])) || text[j] == '#')) {
+                    ++j;
+                }
+                i = (j < text.size() && text[j] == ';') ? j + 1 : i + 1;
+                continue;
+            }
+            if (!isWordByte(c)) {
+                ++i;
+                continue;
+            }
+            term.clear();
+            while (i < text.size() && isWordByte(static_cast<unsigned char>(text[i]))) {
+                if (term.size() < max_term) {
+                    term.push_back(ParserUtils::toLower(text[i]));
+                }
+                ++i;
+            }
+            emit(term);
+        }
+    }
+
+    // Terms of the text a reader would see: script, style and friends are skipped
+    template<typename F>
+    void forEachVisibleTerm(std::string_view html, F&& emit) {
+        HtmlTokenizer tokenizer(html);
+        HtmlToken token;
+        std::string term;
+        int hidden = 0;
+        while (tokenizer.next(token)) {
+            const bool hiding = token.name == "script" || token.name == "style" ||
+                                token.name == "noscript" || token.name == "template";
+            if (token.type == TokenType::StartTag && hiding && !token.selfClosing) {
+                ++hidden;
+            }
+            else if (token.type == TokenType::EndTag && hiding && hidden > 0) {
+                --hidden;
+            }
+            else if (token.type == TokenType::Text && hidden == 0) {
+                forEachTerm(token.text, term, emit);
+            }
+        }
+    }
+
+    inline void putU32(std::string& out, uint32_t v) {
+        for (int i = 0; i < 4; ++i) out.push_back(static_cast<char>((v >> (8 * i)) & 0xFF));
+    }
+
+    inline void putU64(std::string& out, uint64_t v) {
+        for (int i = 0; i < 8; ++i) out.push_back(static_cast<char>((v >> (8 * i)) & 0xFF));
+    }
+
+    inline uint64_t getLE(const char* p, int bytes) {
+        uint64_t v = 0;
+        for (int i = 0; i < bytes; ++i) v |= static_cast<uint64_t>(static_cast<uint8_t>(p[i])) << (8 * i);
+        return v;
+    }
+
+}
+
+
+// Posting lists are (doc delta, term frequency) varint pairs; the first delta is from 0
+struct IndexPostings {
+    std::string data;
+    uint32_t df = 0;
+    uint32_t last_doc = 0;
+
+    void add(uint32_t doc, uint32_t tf) {
+        IndexUtils::putVarint(data, df ? doc - last_doc : doc);
+        IndexUtils::putVarint(data, tf);
+        last_doc = doc;
+        ++df;
+    }
+};
+
+
+// Documents being indexed in memory, searchable until they are written out
+struct IndexMemSegment {
+    uint32_t base_doc = 0;
+    std::vector<std::string> urls;
+    std::unordered_map<std::string, IndexPostings> terms;
+    size_t bytes = 0;
+};
+
+
+// Immutable segment file:
+//   header  "AIDX", version, base doc, doc count, term count, 0, docs offset (u64), dict offset (u64)
+//   postings of every term, back to back
+//   docs    varint length + url, per document
+//   dict    varint length + term, df, postings offset, postings length, last doc; sorted by term
+// The dictionary is kept in memory, postings are read on demand.
+class IndexSegment {
+
+    public:
+
+        struct Term {
+            std::string term;
+            uint32_t df = 0;
+            uint64_t offset = 0;
+            uint64_t length = 0;
+            uint32_t last_doc = 0;
+        };
+
+        static constexpr uint32_t version_ = 1;
+        static constexpr size_t header_size_ = 40;
+
+        ~IndexSegment() {
+            in_.close();
+            if (obsolete_) {
+                std::error_code ec;
+                std::filesystem::remove(path_, ec);
+            }
+        }
+
+        static std::shared_ptr<IndexSegment> open(const std::filesystem::path& path) {
+
+            auto seg = std::shared_ptr<IndexSegment>(new IndexSegment());
+            seg->path_ = path;
+            seg->in_.open(path, std::ios::binary);
+            if (!seg->in_) {
+                return nullptr;
+            }
+
+            char header[header_size_];
+            if (!seg->in_.read(header, header_size_) || std::memcmp(header, "AIDX", 4) != 0 ||
+                IndexUtils::getLE(header + 4, 4) != version_) {
+                return nullptr;
+            }
+            seg->base_doc_ = static_cast<uint32_t>(IndexUtils::getLE(header + 8, 4));
+            const uint32_t doc_count = static_cast<uint32_t>(IndexUtils::getLE(header + 12, 4));
+            const uint32_t term_count = static_cast<uint32_t>(IndexUtils::getLE(header + 16, 4));
+            const uint64_t docs_offset = IndexUtils::getLE(header + 24, 8);
+            const uint64_t dict_offset = IndexUtils::getLE(header + 32, 8);
+
+            seg->in_.seekg(0, std::ios::end);
+            seg->file_size_ = static_cast<uint64_t>(seg->in_.tellg());
+            if (docs_offset > dict_offset || dict_offset > seg->file_size_) {
+                return nullptr;
+            }
+
+            std::string tail(seg->file_size_ - docs_offset, '\0');
+            seg->in_.seekg(static_cast<std::streamoff>(docs_offset));
+            if (!seg->in_.read(&tail[0], static_cast<std::streamsize>(tail.size()))) {
+                return nullptr;
+            }
+
+            const char* p = tail.data();
+            const char* end = tail.data() + tail.size();
+            uint64_t v = 0;
+            seg->urls_.reserve(doc_count);
+            for (uint32_t i = 0; i < doc_count; ++i) {
+                if (!IndexUtils::getVarint(p, end, v) || v > static_cast<uint64_t>(end - p)) {
+                    return nullptr;
+                }
+                seg->urls_.emplace_back(p, v);
+                p += v;
+            }
+
+            seg->terms_.reserve(term_count);
+            for (uint32_t i = 0; i < term_count; ++i) {
+                Term t;
+                if (!IndexUtils::getVarint(p, end, v) || v > static_cast<uint64_t>(end - p)) {
+                    return nullptr;
+                }
+                t.term.assign(p, v);
+                p += v;
+                uint64_t df = 0, last = 0;
+                if (!IndexUtils::getVarint(p, end, df) || !IndexUtils::getVarint(p, end, t.offset) ||
+                    !IndexUtils::getVarint(p, end, t.length) || !IndexUtils::getVarint(p, end, last)) {
+                    return nullptr;
+                }
+                t.df = static_cast<uint32_t>(df);
+                t.last_doc = static_cast<uint32_t>(last);
+                seg->terms_.push_back(std::move(t));
+            }
+            return seg;
+        }
+
+        const Term* find(std::string_view term) const {
+            auto it = std::lower_bound(terms_.begin(), terms_.end(), term,
+                                       [](const Term& t, std::string_view s) { return t.term < s; });
+            return (it != terms_.end() && it->term == term) ? &*it : nullptr;
+        }
+
+        bool read(const Term& t, std::string& out) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            out.resize(t.length);
+            in_.clear();
+            in_.seekg(static_cast<std::streamoff>(t.offset));
+            return t.length == 0 || static_cast<bool>(in_.read(&out[0], static_cast<std::streamsize>(t.length)));
+        }
+
+        // The file is removed once the last reader lets go of the segment
+        void markObsolete() {
+            obsolete_ = true;
+        }
+
+        uint32_t baseDoc() const { return base_doc_; }
+        uint32_t docCount() const { return static_cast<uint32_t>(urls_.size()); }
+        uint64_t fileSize() const { return file_size_; }
+        const std::vector<Term>& terms() const { return terms_; }
+        const std::vector<std::string>& urls() const { return urls_; }
+        const std::filesystem::path& path() const { return path_; }
+
+    private:
+
+        IndexSegment() = default;
+
+        std::filesystem::path path_;
+        std::ifstream in_;
+        std::mutex mutex_;
+        uint32_t base_doc_ = 0;
+        uint64_t file_size_ = 0;
+        std::vector<std::string> urls_;
+        std::vector<Term> terms_;
+        std::atomic<bool> obsolete_{false};
+
+};
+
+
+// Streams a segment file out: postings term by term in sorted order, then docs and dictionary.
+// Written under a temporary name and renamed into place by finish().
+class IndexSegmentWriter {
+
+    public:
+
+        IndexSegmentWriter(const std::filesystem::path& path, uint32_t base_doc)
+            : path_(path), tmp_(path.string() + ".tmp"), base_doc_(base_doc) {
+            out_.open(tmp_, std::ios::binary | std::ios::trunc);
+            const std::string zeros(IndexSegment::header_size_, '\0');
+            out_.write(zeros.data(), static_cast<std::streamsize>(zeros.size()));
+            offset_ = zeros.size();
+        }
+
+        void addTerm(const std::string& term, uint32_t df, uint32_t last_doc, std::string_view postings) {
+            IndexUtils::putVarint(dict_, term.size());
+            dict_.append(term);
+            IndexUtils::putVarint(dict_, df);
+            IndexUtils::putVarint(dict_, offset_);
+            IndexUtils::putVarint(dict_, postings.size());
+            IndexUtils::putVarint(dict_, last_doc);
+            out_.write(postings.data(), static_cast<std::streamsize>(postings.size()));
+            offset_ += postings.size();
+            ++term_count_;
+        }
+
+        void addDoc(const std::string& url) {
+            IndexUtils::putVarint(docs_, url.size());
+            docs_.append(url);
+            ++doc_count_;
+        }
+
+        bool finish() {
+            const uint64_t docs_offset = offset_;
+            const uint64_t dict_offset = offset_ + docs_.size();
+            out_.write(docs_.data(), static_cast<std::streamsize>(docs_.size()));
+            out_.write(dict_.data(), static_cast<std::streamsize>(dict_.size()));
+
+            std::string header("AIDX");
+            IndexUtils::putU32(header, IndexSegment::version_);
+            IndexUtils::putU32(header, base_doc_);
+            IndexUtils::putU32(header, doc_count_);
+            IndexUtils::putU32(header, term_count_);
+            IndexUtils::putU32(header, 0);
+            IndexUtils::putU64(header, docs_offset);
+            IndexUtils::putU64(header, dict_offset);
+            out_.seekp(0);
+            out_.write(header.data(), static_cast<std::streamsize>(header.size()));
+            out_.close();
+            if (!out_) {
+                return false;
+            }
+            std::error_code ec;
+            std::filesystem::rename(tmp_, path_, ec);
+            return !ec;
+        }
+
+    private:
+
+        std::filesystem::path path_;
+        std::filesystem::path tmp_;
+        std::ofstream out_;
+        uint32_t base_doc_;
+        uint64_t offset_ = 0;
+        uint32_t doc_count_ = 0;
+        uint32_t term_count_ = 0;
+        std::string docs_;
+        std::string dict_;
+
+};
+
+
+// Append-only full-text index over fetched pages. addDocument() is safe from any number of
+// threads; full in-memory segments are written out, and runs of small segments merged, by a
+// background thread. The segment list is tracked in a manifest so an index can be reopened.
+class InvertedIndex {
+
+    public:
+
+        explicit InvertedIndex(const std::string& dir) : dir_(dir), opened_(std::chrono::steady_clock::now()) {
+            std::error_code ec;
+            std::filesystem::create_directories(dir_, ec);
+            loadManifest();
+            mem_ = std::make_shared<IndexMemSegment>();
+            mem_->base_doc = next_doc_;
+            worker_ = std::thread(&InvertedIndex::loop, this);
+        }
+
+        InvertedIndex(const InvertedIndex&) = delete;
+        InvertedIndex& operator=(const InvertedIndex&) = delete;
+
+        ~InvertedIndex() {
+            close();
+        }
+
+        // In-memory postings size at which a segment is written out
+        void setFlushBytes(size_t bytes) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            flush_bytes_ = std::max<size_t>(bytes, 4096);
+        }
+
+        // This many adjacent segments of similar size are merged into one
+        void setMergeFactor(size_t n) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            merge_factor_ = std::max<size_t>(n, 2);
+        }
+
+        uint32_t addDocument(const std::string& url, std::string_view html) {
+
+            const auto started = std::chrono::steady_clock::now();
+
+            // tokenizing and counting happen outside the lock, so indexing threads scale;
+            // a page repeats a small vocabulary, so counting by hash beats sorting its tokens
+            thread_local std::unordered_map<std::string, uint32_t> counts;
+            counts.clear();
+            uint64_t tokens = 0;
+            IndexUtils::forEachVisibleTerm(html, [&tokens](const std::string& t) {
+                ++counts[t];
+                ++tokens;
+            });
+
+            uint32_t doc = 0;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                doc = next_doc_++;
+                mem_->urls.push_back(url);
+                mem_->bytes += url.size() + 16;
+                for (const auto& kv : counts) {
+                    auto it = mem_->terms.find(kv.first);
+                    if (it == mem_->terms.end()) {
+                        it = mem_->terms.emplace(kv.first, IndexPostings()).first;
+                        mem_->bytes += kv.first.size() + 64;
+                    }
+                    const size_t before = it->second.data.size();
+                    it->second.add(doc, kv.second);
+                    mem_->bytes += it->second.data.size() - before;
+                }
+
+                ++stats_.docs;
+                stats_.tokens += tokens;
+                stats_.text_bytes += html.size();
+                stats_.index_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+                if (mem_->bytes >= flush_bytes_) {
+                    sealLocked();
+                }
+            }
+            return doc;
+        }
+
+        // Seals the in-memory segment and waits until everything sealed so far is on disk
+        void flush() {
+            std::unique_lock<std::mutex> lock(mutex_);
+            sealLocked();
+            done_cv_.wait(lock, [this]() { return sealed_.empty() || !running_; });
+        }
+
+        // Flushes and stops the background thread; pending merges are dropped
+        void close() {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                if (!running_) {
+                    return;
+                }
+                sealLocked();
+                stopping_ = true;
+            }
+            cv_.notify_all();
+            if (worker_.joinable()) {
+                worker_.join();
+            }
+        }
+
+        // Documents containing every term of the query, best (highest summed tf) first
+        std::vector<IndexHit> search(const std::string& query, size_t limit = 10) {
+
+            std::vector<std::string> terms;
+            std::string term;
+            IndexUtils::forEachTerm(query, term, [&terms](const std::string& t) {
+                terms.push_back(t);
+            });
+            std::sort(terms.begin(), terms.end());
+            terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+            if (terms.empty()) {
+                return {};
+            }
+
+            // a consistent view: segments cover increasing, disjoint doc ranges
+            std::vector<std::shared_ptr<IndexSegment>> segments;
+            std::vector<std::shared_ptr<const IndexMemSegment>> mems;
+            std::unique_lock<std::mutex> lock(mutex_);
+            segments = segments_;
+            mems.assign(failed_.begin(), failed_.end());
+            mems.insert(mems.end(), sealed_.begin(), sealed_.end());
+            // the live segment is read under the lock, the rest after it is released
+            std::vector<std::vector<std::pair<uint32_t, uint32_t>>> live(terms.size());
+            for (size_t i = 0; i < terms.size(); ++i) {
+                auto it = mem_->terms.find(terms[i]);
+                if (it != mem_->terms.end()) {
+                    decode(it->second.data, live[i]);
+                }
+            }
+            const uint32_t live_base = mem_->base_doc;
+            lock.unlock();
+
+            std::vector<std::vector<std::pair<uint32_t, uint32_t>>> lists(terms.size());
+            std::string buffer;
+            for (size_t i = 0; i < terms.size(); ++i) {
+                for (const auto& seg : segments) {
+                    if (const IndexSegment::Term* t = seg->find(terms[i])) {
+                        if (seg->read(*t, buffer)) {
+                            decode(buffer, lists[i]);
+                        }
+                    }
+                }
+                for (const auto& m : mems) {
+                    auto it = m->terms.find(terms[i]);
+                    if (it != m->terms.end()) {
+                        decode(it->second.data, lists[i]);
+                    }
+                }
+                lists[i].insert(lists[i].end(), live[i].begin(), live[i].end());
+                // only out of order after a failed segment write
+                if (!std::is_sorted(lists[i].begin(), lists[i].end())) {
+                    std::sort(lists[i].begin(), lists[i].end());
+                }
+            }
+
+            // intersect starting from the rarest term
+            std::sort(lists.begin(), lists.end(), [](const auto& a, const auto& b) { return a.size() < b.size(); });
+            std::vector<std::pair<uint32_t, uint32_t>> result = std::move(lists[0]);
+            for (size_t i = 1; i < lists.size() && !result.empty(); ++i) {
+                std::vector<std::pair<uint32_t, uint32_t>> next;
+                const auto& other = lists[i];
+                size_t k = 0;
+                for (const auto& r : result) {
+                    // gallop: the other list is usually much longer
+                    size_t step = 1;
+                    while (k + step < other.size() && other[k + step].first < r.first) {
+                        k += step;
+                        step *= 2;
+                    }
+                    while (k < other.size() && other[k].first < r.first) {
+                        ++k;
+                    }
+                    if (k < other.size() && other[k].first == r.first) {
+                        next.emplace_back(r.first, r.second + other[k].second);
+                    }
+                }
+                result.swap(next);
+            }
+
+            const size_t n = std::min(limit, result.size());
+            std::partial_sort(result.begin(), result.begin() + n, result.end(), [](const auto& a, const auto& b) {
+                return a.second != b.second ? a.second > b.second : a.first < b.first;
+            });
+
+            std::vector<IndexHit> hits;
+            hits.reserve(n);
+            for (size_t i = 0; i < n; ++i) {
+                IndexHit hit;
+                hit.doc = result[i].first;
+                hit.score = result[i].second;
+                hit.url = urlOf(hit.doc, segments, mems);
+                if (hit.url.empty() && hit.doc >= live_base) {
+                    std::lock_guard<std::mutex> relock(mutex_);
+                    if (mem_->base_doc == live_base && hit.doc - live_base < mem_->urls.size()) {
+                        hit.url = mem_->urls[hit.doc - live_base];
+                    }
+                }
+                hits.push_back(std::move(hit));
+            }
+            return hits;
+        }
+
+        IndexStats stats() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            IndexStats s = stats_;
+            s.total_docs = next_doc_;
+            s.wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - opened_).count();
+            s.segments = segments_.size();
+            s.unreadable_segments = unreadable_.size();
+            s.pending_segments = sealed_.size() + (mem_->urls.empty() ? 0 : 1);
+            s.disk_bytes = 0;
+            for (const auto& seg : segments_) {
+                s.disk_bytes += seg->fileSize();
+            }
+            return s;
+        }
+
+        const std::string& directory() const {
+            return dir_;
+        }
+
+        // Segments the manifest lists but that failed to open; they stay in the manifest, so
+        // nothing is lost if the file comes back, and their documents are missing from search
+        std::vector<std::string> unreadableSegments() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return unreadable_;
+        }
+
+    private:
+
+        static void decode(const std::string& data, std::vector<std::pair<uint32_t, uint32_t>>& out) {
+            const char* p = data.data();
+            const char* end = p + data.size();
+            uint64_t delta = 0, tf = 0;
+            uint32_t doc = 0;
+            bool first = true;
+            while (p < end && IndexUtils::getVarint(p, end, delta) && IndexUtils::getVarint(p, end, tf)) {
+                doc = first ? static_cast<uint32_t>(delta) : doc + static_cast<uint32_t>(delta);
+                first = false;
+                out.emplace_back(doc, static_cast<uint32_t>(tf));
+            }
+        }
+
+        static std::string urlOf(uint32_t doc, const std::vector<std::shared_ptr<IndexSegment>>& segments,
+                                 const std::vector<std::shared_ptr<const IndexMemSegment>>& mems) {
+            for (const auto& seg : segments) {
+                if (doc >= seg->baseDoc() && doc - seg->baseDoc() < seg->docCount()) {
+                    return seg->urls()[doc - seg->baseDoc()];
+                }
+            }
+            for (const auto& m : mems) {
+                if (doc >= m->base_doc && doc - m->base_doc < m->urls.size()) {
+                    return m->urls[doc - m->base_doc];
+                }
+            }
+            return {};
+        }
+
+        void sealLocked() {
+            if (mem_->urls.empty()) {
+                return;
+            }
+            sealed_.push_back(std::move(mem_));
+            mem_ = std::make_shared<IndexMemSegment>();
+            mem_->base_doc = next_doc_;
+            cv_.notify_all();
+        }
+
+        std::filesystem::path segmentPath(uint64_t gen) const {
+            std::ostringstream name;
+            name << "seg_" << gen << ".idx";
+            return std::filesystem::path(dir_) / name.str();
+        }
+
+        void loadManifest() {
+            std::ifstream in(std::filesystem::path(dir_) / "manifest");
+            std::string key;
+            while (in >> key) {
+                if (key == "next_doc") {
+                    in >> next_doc_;
+                }
+                else if (key == "next_gen") {
+                    in >> next_gen_;
+                }
+                else if (key == "segment") {
+                    std::string name;
+                    in >> name;
+                    if (auto seg = IndexSegment::open(std::filesystem::path(dir_) / name)) {
+                        segments_.push_back(seg);
+                    }
+                    else {
+                        unreadable_.push_back(name);
+                    }
+                }
+            }
+            std::sort(segments_.begin(), segments_.end(), [](const auto& a, const auto& b) {
+                return a->baseDoc() < b->baseDoc();
+            });
+        }
+
+        // Written beside and renamed over the old one, so a crash leaves one or the other
+        bool writeManifestLocked() {
+            const std::filesystem::path path = std::filesystem::path(dir_) / "manifest";
+            const std::filesystem::path tmp = std::filesystem::path(dir_) / "manifest.tmp";
+            {
+                std::ofstream out(tmp, std::ios::trunc);
+                out << "next_doc " << next_doc_ << "\nnext_gen " << next_gen_ << '\n';
+                for (const auto& seg : segments_) {
+                    out << "segment " << seg->path().filename().string() << '\n';
+                }
+                for (const auto& name : unreadable_) {
+                    out << "segment " << name << '\n';
+                }
+                if (!out) {
+                    return false;
+                }
+            }
+            std::error_code ec;
+            std::filesystem::rename(tmp, path, ec);
+            return !ec;
+        }
+
+        bool writeMemSegment(const IndexMemSegment& mem, const std::filesystem::path& path) {
+            std::vector<const std::pair<const std::string, IndexPostings>*> sorted;
+            sorted.reserve(mem.terms.size());
+            for (const auto& kv : mem.terms) {
+                sorted.push_back(&kv);
+            }
+            std::sort(sorted.begin(), sorted.end(), [](const auto* a, const auto* b) { return a->first < b->first; });
+
+            IndexSegmentWriter writer(path, mem.base_doc);
+            for (const auto* kv : sorted) {
+                writer.addTerm(kv->first, kv->second.df, kv->second.last_doc, kv->second.data);
+            }
+            for (const auto& url : mem.urls) {
+                writer.addDoc(url);
+            }
+            return writer.finish();
+        }
+
+        // k-way merge of adjacent segments. Doc ranges are disjoint and ordered, so a term's
+        // lists are concatenated: only the first delta of each list is re-encoded.
+        bool mergeSegments(const std::vector<std::shared_ptr<IndexSegment>>& inputs, const std::filesystem::path& path) {
+
+            IndexSegmentWriter writer(path, inputs.front()->baseDoc());
+            std::vector<size_t> pos(inputs.size(), 0);
+            std::string merged;
+            std::string buffer;
+
+            while (true) {
+                const std::string* smallest = nullptr;
+                for (size_t i = 0; i < inputs.size(); ++i) {
+                    if (pos[i] < inputs[i]->terms().size()) {
+                        const std::string& t = inputs[i]->terms()[pos[i]].term;
+                        if (!smallest || t < *smallest) {
+                            smallest = &t;
+                        }
+                    }
+                }
+                if (!smallest) {
+                    break;
+                }
+                const std::string term = *smallest;
+
+                merged.clear();
+                uint32_t df = 0;
+                uint32_t last_doc = 0;
+                for (size_t i = 0; i < inputs.size(); ++i) {
+                    if (pos[i] >= inputs[i]->terms().size() || inputs[i]->terms()[pos[i]].term != term) {
+                        continue;
+                    }
+                    const IndexSegment::Term& t = inputs[i]->terms()[pos[i]++];
+                    if (!inputs[i]->read(t, buffer)) {
+                        return false;
+                    }
+                    const char* p = buffer.data();
+                    const char* end = p + buffer.size();
+                    uint64_t first = 0;
+                    if (!IndexUtils::getVarint(p, end, first)) {
+                        return false;
+                    }
+                    IndexUtils::putVarint(merged, df ? first - last_doc : first);
+                    merged.append(p, static_cast<size_t>(end - p));
+                    df += t.df;
+                    last_doc = t.last_doc;
+                }
+                writer.addTerm(term, df, last_doc, merged);
+            }
+
+            for (const auto& seg : inputs) {
+                for (const auto& url : seg->urls()) {
+                    writer.addDoc(url);
+                }
+            }
+            return writer.finish();
+        }
+
+        // The window of merge_factor_ adjacent segments with the smallest total size, if none
+        // of them is much larger than the rest of the window (so big segments are not rewritten
+        // for every small one)
+        bool pickMergeLocked(size_t& first) const {
+            if (merge_blocked_ || segments_.size() < merge_factor_) {
+                return false;
+            }
+            bool found = false;
+            uint64_t best = 0;
+            for (size_t i = 0; i + merge_factor_ <= segments_.size(); ++i) {
+                uint64_t total = 0;
+                uint64_t largest = 0;
+                for (size_t k = i; k < i + merge_factor_; ++k) {
+                    total += segments_[k]->fileSize();
+                    largest = std::max(largest, segments_[k]->fileSize());
+                }
+                if (largest * 2 > total) {
+                    continue;
+                }
+                if (!found || total < best) {
+                    found = true;
+                    best = total;
+                    first = i;
+                }
+            }
+            return found;
+        }
+
+        void loop() {
+
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (true) {
+
+                size_t first = 0;
+                cv_.wait(lock, [&]() { return stopping_ || !sealed_.empty() || pickMergeLocked(first); });
+
+                if (!sealed_.empty()) {
+                    std::shared_ptr<IndexMemSegment> mem = sealed_.front();
+                    const std::filesystem::path path = segmentPath(next_gen_++);
+                    lock.unlock();
+                    bool ok = writeMemSegment(*mem, path);
+                    std::shared_ptr<IndexSegment> seg = ok ? IndexSegment::open(path) : nullptr;
+                    lock.lock();
+                    if (seg) {
+                        segments_.push_back(seg);
+                        ++stats_.flushes;
+                        merge_blocked_ = false;
+                        writeManifestLocked();
+                    }
+                    else {
+                        // the documents stay searchable in memory only
+                        failed_.push_back(mem);
+                        ++stats_.failed_flushes;
+                    }
+                    sealed_.pop_front();
+                    done_cv_.notify_all();
+                    continue;
+                }
+
+                if (stopping_) {
+                    break;
+                }
+
+                if (pickMergeLocked(first)) {
+                    std::vector<std::shared_ptr<IndexSegment>> inputs(segments_.begin() + first,
+                                                                      segments_.begin() + first + merge_factor_);
+                    const std::filesystem::path path = segmentPath(next_gen_++);
+                    lock.unlock();
+                    bool ok = mergeSegments(inputs, path);
+                    std::shared_ptr<IndexSegment> seg = ok ? IndexSegment::open(path) : nullptr;
+                    lock.lock();
+                    if (!seg) {
+                        std::error_code ec;
+                        std::filesystem::remove(path, ec);
+                        // leave the segments as they are until the next flush rather than retry in a loop
+                        merge_blocked_ = true;
+                        continue;
+                    }
+                    // only flushes append to segments_, so the window is still in place
+                    segments_.erase(segments_.begin() + first, segments_.begin() + first + merge_factor_);
+                    segments_.insert(segments_.begin() + first, seg);
+                    ++stats_.merges;
+                    writeManifestLocked();
+                    for (auto& old : inputs) {
+                        old->markObsolete();
+                    }
+                }
+            }
+
+            running_ = false;
+            done_cv_.notify_all();
+        }
+
+        std::string dir_;
+        std::chrono::steady_clock::time_point opened_;
+
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        std::condition_variable done_cv_;
+        std::thread worker_;
+
+        std::shared_ptr<IndexMemSegment> mem_;
+        std::deque<std::shared_ptr<IndexMemSegment>> sealed_;
+        std::vector<std::shared_ptr<IndexMemSegment>> failed_;
+        std::vector<std::shared_ptr<IndexSegment>> segments_;
+        std::vector<std::string> unreadable_;
+        IndexStats stats_;
+
+        uint32_t next_doc_ = 0;
+        uint64_t next_gen_ = 0;
+        size_t flush_bytes_ = 64 * 1024 * 1024;
+        size_t merge_factor_ = 4;
+        bool merge_blocked_ = false;
+        bool stopping_ = false;
+        bool running_ = true;
+
+};
+
+#endif
\ No newline at end of file
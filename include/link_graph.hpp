@@ -0,0 +1,433 @@
+#ifndef LINK_GRAPH_HPP
+#define LINK_GRAPH_HPP
+
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+
+struct LinkGraphStats {
+    size_t nodes = 0;
+    size_t edges = 0;            // compacted, duplicates removed
+    size_t pending_edges = 0;    // logged since the last compaction
+    size_t csr_bytes = 0;        // neighbor lists plus row offsets
+    size_t id_bytes = 0;         // fingerprint to id map, estimated from its nodes and buckets
+    size_t node_bytes = 0;       // out-degrees and published ranks
+    size_t log_bytes = 0;        // edge log, by capacity
+    size_t compactions = 0;
+    int last_iterations = 0;     // PageRank iterations of the last rank() call
+    double last_delta = 0.0;     // L1 change of the final iteration
+
+    size_t totalBytes() const {
+        return csr_bytes + id_bytes + node_bytes + log_bytes;
+    }
+
+    // Everything the graph holds between rank() calls, per compacted edge
+    double bytesPerEdge() const {
+        return edges ? static_cast<double>(totalBytes()) / edges : 0.0;
+    }
+
+    double csrBytesPerEdge() const {
+        return edges ? static_cast<double>(csr_bytes) / edges : 0.0;
+    }
+};
+
+
+namespace LinkGraphUtils {
+
+    inline void putVarint(std::vector<uint8_t>& out, uint32_t v) {
+        while (v >= 0x80) {
+            out.push_back(static_cast<uint8_t>(v | 0x80));
+            v >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(v));
+    }
+
+    inline uint32_t getVarint(const uint8_t*& p) {
+        uint32_t v = 0;
+        int shift = 0;
+        while (*p & 0x80) {
+            v |= static_cast<uint32_t>(*p++ & 0x7F) << shift;
+            shift += 7;
+        }
+        v |= static_cast<uint32_t>(*p++) << shift;
+        return v;
+    }
+
+    // Runs fn(begin, end) over [0, n) in chunks on the pool. The caller works through chunks
+    // too, so this finishes even from inside a pool task or with every worker busy.
+    template<typename F>
+    void parallelFor(ThreadPool* pool, size_t n, size_t chunk, F fn) {
+
+        struct Job {
+            std::atomic<size_t> next{0};
+            size_t done = 0;
+            std::mutex mutex;
+            std::condition_variable cv;
+        };
+
+        const size_t chunks = (n + chunk - 1) / chunk;
+        auto job = std::make_shared<Job>();
+
+        // fn lives on the caller's stack: a helper that starts late finds no chunk left and
+        // returns without touching it, and the caller waits for every chunk that was taken
+        auto work = [job, chunks, chunk, n, fn_ptr = &fn]() {
+            while (true) {
+                const size_t c = job->next.fetch_add(1);
+                if (c >= chunks) {
+                    return;
+                }
+                (*fn_ptr)(c * chunk, std::min(n, (c + 1) * chunk));
+                std::lock_guard<std::mutex> lock(job->mutex);
+                if (++job->done == chunks) {
+                    job->cv.notify_all();
+                }
+            }
+        };
+
+        if (pool) {
+            const size_t helpers = std::min<size_t>(chunks > 0 ? chunks - 1 : 0, std::thread::hardware_concurrency());
+            for (size_t i = 0; i < helpers; ++i) {
+                pool->enqueue(work);
+            }
+        }
+
+        work();
+
+        std::unique_lock<std::mutex> lock(job->mutex);
+        job->cv.wait(lock, [&]() { return job->done == chunks; });
+    }
+
+}
+
+
+// Directed link graph over URL fingerprints. Edges are appended to a log by any thread and
+// folded into a CSR of in-links (sorted, delta + varint encoded) by compact(); rank() runs
+// warm-started PageRank over the CSR. compact() and rank() are meant for one driving thread,
+// which may be a pool task: lookups only wait for the brief publish of new scores.
+class LinkGraph {
+
+    public:
+
+        LinkGraph() = default;
+
+        LinkGraph(const LinkGraph&) = delete;
+        LinkGraph& operator=(const LinkGraph&) = delete;
+
+        void setDamping(double d) {
+            damping_ = std::min(0.99, std::max(0.0, d));
+        }
+
+        // compactionDue() once the log holds this fraction of the compacted edge count
+        void setCompactRatio(double r) {
+            compact_ratio_ = std::max(0.0, r);
+        }
+
+        void addEdges(uint64_t from, const std::vector<uint64_t>& to) {
+            std::lock_guard<std::mutex> lock(log_mutex_);
+            const uint32_t src = idLocked(from);
+            for (uint64_t fp : to) {
+                const uint32_t dst = idLocked(fp);
+                if (dst != src) {
+                    log_.push_back(Edge{dst, src});
+                }
+            }
+        }
+
+        size_t pendingEdges() {
+            std::lock_guard<std::mutex> lock(log_mutex_);
+            return log_.size();
+        }
+
+        // Every compaction rewrites the whole CSR, so compacting after a fixed number of new
+        // edges costs quadratic time over a crawl; waiting until the log is a fraction of the
+        // graph keeps the total linear. Does not wait for a compaction in progress.
+        bool compactionDue() {
+            std::lock_guard<std::mutex> lock(log_mutex_);
+            return !log_.empty() && log_.size() >= compact_ratio_ * edges_.load();
+        }
+
+        // Merges the edge log into the CSR. Rows are rebuilt in one sequential pass, so the cost
+        // is linear in the graph size; compactionDue() says when enough edges are batched.
+        void compact() {
+
+            std::lock_guard<std::mutex> compute(compute_mutex_);
+
+            std::vector<Edge> log;
+            size_t nodes = 0;
+            {
+                std::lock_guard<std::mutex> lock(log_mutex_);
+                log.swap(log_);
+                nodes = ids_.size();
+            }
+            if (log.empty() && nodes == nodes_) {
+                return;
+            }
+
+            std::sort(log.begin(), log.end());
+
+            std::vector<uint64_t> offsets(nodes + 1, 0);
+            std::vector<uint8_t> bytes;
+            bytes.reserve(bytes_.size() + log.size() * 2);
+            out_degree_.resize(nodes, 0);
+
+            std::vector<uint32_t> row;
+            size_t edges = 0;
+            size_t k = 0;
+            for (uint32_t v = 0; v < nodes; ++v) {
+
+                row.clear();
+                if (v < nodes_) {
+                    const uint8_t* p = bytes_.data() + offsets_[v];
+                    const uint8_t* end = bytes_.data() + offsets_[v + 1];
+                    uint32_t prev = 0;
+                    while (p < end) {
+                        prev += LinkGraphUtils::getVarint(p);
+                        row.push_back(prev);
+                    }
+                }
+
+                // merge the logged in-links of v, counting out-degree only for new edges
+                size_t old_end = row.size();
+                size_t i = 0;
+                while (k < log.size() && log[k].dst == v) {
+                    const uint32_t src = log[k++].src;
+                    while (i < old_end && row[i] < src) {
+                        ++i;
+                    }
+                    if ((i < old_end && row[i] == src) || (row.size() > old_end && row.back() == src)) {
+                        continue;
+                    }
+                    row.push_back(src);
+                    ++out_degree_[src];
+                }
+                if (row.size() > old_end) {
+                    std::inplace_merge(row.begin(), row.begin() + old_end, row.end());
+                }
+
+                offsets[v] = bytes.size();
+                uint32_t prev = 0;
+                for (uint32_t src : row) {
+                    LinkGraphUtils::putVarint(bytes, src - prev);
+                    prev = src;
+                }
+                edges += row.size();
+            }
+            offsets[nodes] = bytes.size();
+
+            bytes.shrink_to_fit();
+            bytes_.swap(bytes);
+            offsets_.swap(offsets);
+            nodes_ = nodes;
+            edges_ = edges;
+            ++compactions_;
+        }
+
+        // Power iteration from the previous scores (new nodes start at the mean), until the L1
+        // change drops below tolerance. Returns the iterations run.
+        int rank(ThreadPool* pool = nullptr, int max_iterations = 30, double tolerance = 1e-6) {
+
+            std::lock_guard<std::mutex> compute(compute_mutex_);
+
+            const size_t n = nodes_;
+            if (n == 0) {
+                return 0;
+            }
+
+            std::vector<double> rank;
+            {
+                std::lock_guard<std::mutex> lock(rank_mutex_);
+                rank = rank_;
+            }
+            const size_t known = rank.size();
+            rank.resize(n, 1.0 / n);
+            if (known != n) {
+                double sum = 0.0;
+                for (double r : rank) {
+                    sum += r;
+                }
+                for (double& r : rank) {
+                    r /= sum;
+                }
+            }
+
+            std::vector<double> contrib(n);
+            std::vector<double> next(n);
+            const size_t chunk = 16384;
+            const size_t chunks = (n + chunk - 1) / chunk;
+            std::vector<double> dangling(chunks);
+            std::vector<double> delta(chunks);
+
+            int iterations = 0;
+            double change = 0.0;
+            while (iterations < max_iterations) {
+
+                LinkGraphUtils::parallelFor(pool, n, chunk, [&](size_t b, size_t e) {
+                    double d = 0.0;
+                    for (size_t u = b; u < e; ++u) {
+                        if (out_degree_[u]) {
+                            contrib[u] = rank[u] / out_degree_[u];
+                        }
+                        else {
+                            contrib[u] = 0.0;
+                            d += rank[u];
+                        }
+                    }
+                    dangling[b / chunk] = d;
+                });
+
+                double dangling_sum = 0.0;
+                for (double d : dangling) {
+                    dangling_sum += d;
+                }
+                // teleport plus the mass of dangling pages, spread evenly
+                const double base = (1.0 - damping_) / n + damping_ * dangling_sum / n;
+
+                LinkGraphUtils::parallelFor(pool, n, chunk, [&](size_t b, size_t e) {
+                    double diff = 0.0;
+                    for (size_t v = b; v < e; ++v) {
+                        const uint8_t* p = bytes_.data() + offsets_[v];
+                        const uint8_t* end = bytes_.data() + offsets_[v + 1];
+                        uint32_t src = 0;
+                        double sum = 0.0;
+                        while (p < end) {
+                            src += LinkGraphUtils::getVarint(p);
+                            sum += contrib[src];
+                        }
+                        next[v] = base + damping_ * sum;
+                        diff += std::fabs(next[v] - rank[v]);
+                    }
+                    delta[b / chunk] = diff;
+                });
+
+                rank.swap(next);
+                ++iterations;
+
+                change = 0.0;
+                for (double d : delta) {
+                    change += d;
+                }
+                if (change < tolerance) {
+                    break;
+                }
+            }
+
+            std::lock_guard<std::mutex> lock(rank_mutex_);
+            rank_.swap(rank);
+            last_iterations_ = iterations;
+            last_delta_ = change;
+            return iterations;
+        }
+
+        // Rank relative to the mean (1.0 is an average page), 0 for pages not ranked yet
+        double score(uint64_t fp) {
+            uint32_t id = 0;
+            {
+                std::lock_guard<std::mutex> lock(log_mutex_);
+                auto it = ids_.find(fp);
+                if (it == ids_.end()) {
+                    return 0.0;
+                }
+                id = it->second;
+            }
+            std::lock_guard<std::mutex> lock(rank_mutex_);
+            return id < rank_.size() ? rank_[id] * rank_.size() : 0.0;
+        }
+
+        // score() for many pages under one lock of each kind; out[i] is the score of fps[i]
+        void scores(const std::vector<uint64_t>& fps, std::vector<double>& out) {
+            std::vector<uint32_t> ids(fps.size(), std::numeric_limits<uint32_t>::max());
+            {
+                std::lock_guard<std::mutex> lock(log_mutex_);
+                for (size_t i = 0; i < fps.size(); ++i) {
+                    auto it = ids_.find(fps[i]);
+                    if (it != ids_.end()) {
+                        ids[i] = it->second;
+                    }
+                }
+            }
+            out.assign(fps.size(), 0.0);
+            std::lock_guard<std::mutex> lock(rank_mutex_);
+            const double n = static_cast<double>(rank_.size());
+            for (size_t i = 0; i < ids.size(); ++i) {
+                if (ids[i] < rank_.size()) {
+                    out[i] = rank_[ids[i]] * n;
+                }
+            }
+        }
+
+        LinkGraphStats stats() {
+            LinkGraphStats s;
+            {
+                std::lock_guard<std::mutex> lock(log_mutex_);
+                s.pending_edges = log_.size();
+                s.log_bytes = log_.capacity() * sizeof(Edge);
+                // each entry is a heap node (next pointer plus key and id) the allocator rounds
+                // up to 16 bytes, plus a bucket pointer
+                const size_t node = (sizeof(void*) + sizeof(std::pair<const uint64_t, uint32_t>) + 15) / 16 * 16;
+                s.id_bytes = ids_.size() * node + ids_.bucket_count() * sizeof(void*);
+            }
+            std::lock_guard<std::mutex> compute(compute_mutex_);
+            s.nodes = nodes_;
+            s.edges = edges_;
+            s.csr_bytes = bytes_.capacity() + offsets_.capacity() * sizeof(uint64_t);
+            s.node_bytes = out_degree_.capacity() * sizeof(uint32_t);
+            s.compactions = compactions_;
+            std::lock_guard<std::mutex> lock(rank_mutex_);
+            s.node_bytes += rank_.capacity() * sizeof(double);
+            s.last_iterations = last_iterations_;
+            s.last_delta = last_delta_;
+            return s;
+        }
+
+    private:
+
+        struct Edge {
+            uint32_t dst;
+            uint32_t src;
+
+            bool operator<(const Edge& other) const {
+                return dst != other.dst ? dst < other.dst : src < other.src;
+            }
+        };
+
+        uint32_t idLocked(uint64_t fp) {
+            auto it = ids_.emplace(fp, static_cast<uint32_t>(ids_.size())).first;
+            return it->second;
+        }
+
+        // ids and the edge log
+        std::mutex log_mutex_;
+        std::unordered_map<uint64_t, uint32_t> ids_;
+        std::vector<Edge> log_;
+
+        // CSR, only touched by compact() and rank()
+        std::mutex compute_mutex_;
+        std::vector<uint64_t> offsets_;
+        std::vector<uint8_t> bytes_;
+        std::vector<uint32_t> out_degree_;
+        size_t nodes_ = 0;
+        std::atomic<size_t> edges_{0};   // also read by compactionDue()
+        size_t compactions_ = 0;
+
+        // published scores
+        std::mutex rank_mutex_;
+        std::vector<double> rank_;
+        int last_iterations_ = 0;
+        double last_delta_ = 0.0;
+
+        double damping_ = 0.85;
+        double compact_ratio_ = 0.25;
+
+};
+
+#endif
\ No newline at end of file
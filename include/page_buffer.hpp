@@ -0,0 +1,245 @@
+#ifndef PAGE_BUFFER_HPP
+#define PAGE_BUFFER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+
+class PageBufferPool;
+
+// Backing storage for one page body. Slabs are owned by their pool and only ever
+// reached through PageRef handles.
+struct PageSlab {
+    std::unique_ptr<char[]> data;
+    size_t size = 0;
+    size_t capacity = 0;
+    std::atomic<int> refs{0};
+    PageBufferPool* pool = nullptr;
+};
+
+
+// Reference-counted handle to a pooled page body. Copies share the slab (no byte copy);
+// the slab goes back to its pool when the last handle is gone.
+class PageRef {
+
+    public:
+
+        PageRef() = default;
+
+        PageRef(const PageRef& other) : slab_(other.slab_) {
+            if (slab_) {
+                slab_->refs.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        PageRef(PageRef&& other) noexcept : slab_(std::exchange(other.slab_, nullptr)) {}
+
+        PageRef& operator=(PageRef other) noexcept {
+            std::swap(slab_, other.slab_);
+            return *this;
+        }
+
+        ~PageRef() {
+            reset();
+        }
+
+        void reset();
+
+        explicit operator bool() const {
+            return slab_ != nullptr;
+        }
+
+        const char* data() const {
+            return slab_ ? slab_->data.get() : nullptr;
+        }
+
+        size_t size() const {
+            return slab_ ? slab_->size : 0;
+        }
+
+        bool empty() const {
+            return size() == 0;
+        }
+
+        std::string_view view() const {
+            return slab_ ? std::string_view(slab_->data.get(), slab_->size) : std::string_view();
+        }
+
+        int useCount() const {
+            return slab_ ? slab_->refs.load(std::memory_order_relaxed) : 0;
+        }
+
+        // Writers only: the page is filled by its producer before it is shared
+        void append(const char* bytes, size_t n) {
+            if (!slab_ || n == 0) {
+                return;
+            }
+            reserve(slab_->size + n);
+            std::memcpy(slab_->data.get() + slab_->size, bytes, n);
+            slab_->size += n;
+        }
+
+        void reserve(size_t n);
+
+        void clear() {
+            if (slab_) {
+                slab_->size = 0;
+            }
+        }
+
+    private:
+
+        friend class PageBufferPool;
+
+        explicit PageRef(PageSlab* slab) : slab_(slab) {}
+
+        PageSlab* slab_ = nullptr;
+
+};
+
+
+struct PagePoolStats {
+    size_t slabs_total = 0;       // slabs alive, in use or free
+    size_t slabs_in_use = 0;
+    size_t slabs_free = 0;
+    size_t bytes_reserved = 0;    // capacity held by all live slabs
+    size_t bytes_free = 0;        // capacity parked in the free list
+    uint64_t acquired = 0;
+    uint64_t reused = 0;          // acquisitions served from the free list
+    uint64_t discarded = 0;       // slabs freed instead of recycled (over the limits)
+};
+
+
+class PageBufferPool {
+
+    public:
+
+        PageBufferPool() = default;
+
+        PageBufferPool(const PageBufferPool&) = delete;
+        PageBufferPool& operator=(const PageBufferPool&) = delete;
+
+        // Every PageRef must be gone before the pool is destroyed
+        ~PageBufferPool() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (PageSlab* s : free_) {
+                delete s;
+            }
+            free_.clear();
+        }
+
+        // Free slabs kept around, and the largest slab that is worth keeping
+        void setLimits(size_t max_free_slabs, size_t max_slab_bytes) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            max_free_slabs_ = max_free_slabs;
+            max_slab_bytes_ = max_slab_bytes;
+        }
+
+        PageRef acquire(size_t size_hint = 0) {
+
+            PageSlab* slab = nullptr;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                ++stats_.acquired;
+                ++stats_.slabs_in_use;
+                if (!free_.empty()) {
+                    // the last slab returned is the warmest in cache
+                    slab = free_.back();
+                    free_.pop_back();
+                    --stats_.slabs_free;
+                    stats_.bytes_free -= slab->capacity;
+                    ++stats_.reused;
+                }
+                else {
+                    ++stats_.slabs_total;
+                }
+            }
+
+            if (!slab) {
+                slab = new PageSlab();
+                slab->pool = this;
+            }
+
+            slab->size = 0;
+            slab->refs.store(1, std::memory_order_relaxed);
+
+            PageRef ref(slab);
+            ref.reserve(size_hint);
+            return ref;
+        }
+
+        PagePoolStats stats() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            PagePoolStats s = stats_;
+            s.bytes_reserved = reserved_.load(std::memory_order_relaxed);
+            return s;
+        }
+
+    private:
+
+        friend class PageRef;
+
+        void addReserved(size_t n) {
+            reserved_.fetch_add(n, std::memory_order_relaxed);
+        }
+
+        void recycle(PageSlab* slab) {
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            --stats_.slabs_in_use;
+
+            if (free_.size() >= max_free_slabs_ || slab->capacity > max_slab_bytes_) {
+                ++stats_.discarded;
+                --stats_.slabs_total;
+                reserved_.fetch_sub(slab->capacity, std::memory_order_relaxed);
+                delete slab;
+                return;
+            }
+
+            free_.push_back(slab);
+            ++stats_.slabs_free;
+            stats_.bytes_free += slab->capacity;
+        }
+
+        std::mutex mutex_;
+        std::vector<PageSlab*> free_;
+        PagePoolStats stats_;
+        std::atomic<size_t> reserved_{0};
+        size_t max_free_slabs_ = 256;
+        size_t max_slab_bytes_ = 8 * 1024 * 1024;
+
+};
+
+
+inline void PageRef::reserve(size_t n) {
+    if (!slab_ || n <= slab_->capacity) {
+        return;
+    }
+    size_t cap = slab_->capacity ? slab_->capacity : 4096;
+    while (cap < n) {
+        cap *= 2;
+    }
+    std::unique_ptr<char[]> grown(new char[cap]);
+    if (slab_->size) {
+        std::memcpy(grown.get(), slab_->data.get(), slab_->size);
+    }
+    slab_->data = std::move(grown);
+    slab_->pool->addReserved(cap - slab_->capacity);
+    slab_->capacity = cap;
+}
+
+inline void PageRef::reset() {
+    if (slab_ && slab_->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        slab_->pool->recycle(slab_);
+    }
+    slab_ = nullptr;
+}
+
+#endif
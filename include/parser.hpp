@@ -6,10 +6,15 @@
 #include <string>
 #include <unordered_map>
 #include <memory>
+#include <functional>
+#include <string_view>
+#include <cstdint>
+#include <cstring>
 
 
 enum class NodeType { Element, Text, Comment };
 
+// Text and attribute values are UTF-8 when built from a decoded page (see encoding.hpp)
 struct Node {
     NodeType type;
     std::string name;
@@ -20,6 +25,454 @@ struct Node {
 };
 
 
+namespace ParserUtils {
+
+    inline char toLower(char c) {
+        return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + ('a' - 'A')) : c;
+    }
+
+    inline bool isSpace(char c) {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+    }
+
+    inline bool iequals(std::string_view a, std::string_view b) {
+        if (a.size() != b.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < a.size(); ++i) {
+            if (toLower(a[i]) != toLower(b[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    template<typename Out>
+    void appendCodePoint(Out& out, uint32_t cp) {
+        char b[4];
+        if (cp < 0x80) {
+            b[0] = static_cast<char>(cp);
+            out.append(b, 1);
+        }
+        else if (cp < 0x800) {
+            b[0] = static_cast<char>(0xC0 | (cp >> 6));
+            b[1] = static_cast<char>(0x80 | (cp & 0x3F));
+            out.append(b, 2);
+        }
+        else if (cp < 0x10000) {
+            b[0] = static_cast<char>(0xE0 | (cp >> 12));
+            b[1] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            b[2] = static_cast<char>(0x80 | (cp & 0x3F));
+            out.append(b, 3);
+        }
+        else {
+            b[0] = static_cast<char>(0xF0 | (cp >> 18));
+            b[1] = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+            b[2] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            b[3] = static_cast<char>(0x80 | (cp & 0x3F));
+            out.append(b, 4);
+        }
+    }
+
+    // Code points of windows-1252 bytes 0x80..0x9F; the rest of its upper half is Latin-1
+    inline const uint16_t* windows1252C1() {
+        static const uint16_t c1[32] = {
+            0x20AC, 0x0081, 0x201A, 0x0192, 0x201E, 0x2026, 0x2020, 0x2021,
+            0x02C6, 0x2030, 0x0160, 0x2039, 0x0152, 0x008D, 0x017D, 0x008F,
+            0x0090, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014,
+            0x02DC, 0x2122, 0x0161, 0x203A, 0x0153, 0x009D, 0x017E, 0x0178
+        };
+        return c1;
+    }
+
+    struct NamedEntity {
+        std::string_view name;
+        uint32_t code_point;
+    };
+
+    inline size_t entitySlot(std::string_view name) {
+        return (name.size() * 31 + static_cast<unsigned char>(name[0]) * 7 +
+                static_cast<unsigned char>(name[name.size() / 2]) * 3 +
+                static_cast<unsigned char>(name.back())) & 255;
+    }
+
+    // The references that show up in real pages (the full HTML list is over 2000 names), in an
+    // open-addressed table of 256 slots
+    inline const NamedEntity* namedEntities() {
+        static const auto table = [] {
+            const NamedEntity entities[] = {
+                {"amp", '&'}, {"lt", '<'}, {"gt", '>'}, {"quot", '"'}, {"apos", '\''}, {"nbsp", 0xA0},
+                {"copy", 0xA9}, {"reg", 0xAE}, {"trade", 0x2122}, {"hellip", 0x2026}, {"mdash", 0x2014},
+                {"ndash", 0x2013}, {"lsquo", 0x2018}, {"rsquo", 0x2019}, {"sbquo", 0x201A}, {"ldquo", 0x201C},
+                {"rdquo", 0x201D}, {"bdquo", 0x201E}, {"laquo", 0xAB}, {"raquo", 0xBB}, {"lsaquo", 0x2039},
+                {"rsaquo", 0x203A}, {"bull", 0x2022}, {"middot", 0xB7}, {"euro", 0x20AC}, {"pound", 0xA3},
+                {"yen", 0xA5}, {"cent", 0xA2}, {"sect", 0xA7}, {"para", 0xB6}, {"deg", 0xB0}, {"plusmn", 0xB1},
+                {"times", 0xD7}, {"divide", 0xF7}, {"frac12", 0xBD}, {"frac14", 0xBC}, {"frac34", 0xBE},
+                {"shy", 0xAD}, {"iexcl", 0xA1}, {"iquest", 0xBF}, {"thinsp", 0x2009}, {"ensp", 0x2002},
+                {"emsp", 0x2003}, {"zwnj", 0x200C}, {"zwj", 0x200D}, {"szlig", 0xDF}, {"Agrave", 0xC0},
+                {"Aacute", 0xC1}, {"Acirc", 0xC2}, {"Auml", 0xC4}, {"Aring", 0xC5}, {"AElig", 0xC6},
+                {"Ccedil", 0xC7}, {"Egrave", 0xC8}, {"Eacute", 0xC9}, {"Ntilde", 0xD1}, {"Oacute", 0xD3},
+                {"Ouml", 0xD6}, {"Oslash", 0xD8}, {"Uuml", 0xDC}, {"agrave", 0xE0}, {"aacute", 0xE1},
+                {"acirc", 0xE2}, {"atilde", 0xE3}, {"auml", 0xE4}, {"aring", 0xE5}, {"aelig", 0xE6},
+                {"ccedil", 0xE7}, {"egrave", 0xE8}, {"eacute", 0xE9}, {"ecirc", 0xEA}, {"euml", 0xEB},
+                {"igrave", 0xEC}, {"iacute", 0xED}, {"icirc", 0xEE}, {"iuml", 0xEF}, {"ntilde", 0xF1},
+                {"ograve", 0xF2}, {"oacute", 0xF3}, {"ocirc", 0xF4}, {"otilde", 0xF5}, {"ouml", 0xF6},
+                {"oslash", 0xF8}, {"ugrave", 0xF9}, {"uacute", 0xFA}, {"ucirc", 0xFB}, {"uuml", 0xFC},
+                {"yacute", 0xFD}, {"yuml", 0xFF}
+            };
+            struct { NamedEntity slots[256]; } t{};
+            for (const NamedEntity& e : entities) {
+                size_t slot = entitySlot(e.name);
+                while (!t.slots[slot].name.empty()) {
+                    slot = (slot + 1) & 255;
+                }
+                t.slots[slot] = e;
+            }
+            return t;
+        }();
+        return table.slots;
+    }
+
+    inline bool namedEntity(std::string_view name, uint32_t& code_point) {
+        const NamedEntity* table = namedEntities();
+        for (size_t slot = entitySlot(name); !table[slot].name.empty(); slot = (slot + 1) & 255) {
+            if (table[slot].name == name) {
+                code_point = table[slot].code_point;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Decodes the character reference starting at s[0] == '&' into utf8 (up to 4 bytes).
+    // Returns the bytes consumed, 0 when there is no reference and '&' stands for itself.
+    inline size_t characterReference(std::string_view s, char* utf8, size_t& utf8_len) {
+
+        struct Sink {
+            char* p;
+            size_t n;
+            void append(const char* b, size_t len) {
+                std::memcpy(p + n, b, len);
+                n += len;
+            }
+        } sink{utf8, 0};
+
+        size_t i = 1;
+        if (i < s.size() && s[i] == '#') {
+            ++i;
+            const bool hex = i < s.size() && (s[i] == 'x' || s[i] == 'X');
+            i += hex;
+            const size_t digits = i;
+            uint32_t cp = 0;
+            while (i < s.size() && i - digits < 8) {
+                const char c = s[i];
+                int v = -1;
+                if (c >= '0' && c <= '9') v = c - '0';
+                else if (hex && c >= 'a' && c <= 'f') v = c - 'a' + 10;
+                else if (hex && c >= 'A' && c <= 'F') v = c - 'A' + 10;
+                if (v < 0) {
+                    break;
+                }
+                cp = cp * (hex ? 16 : 10) + static_cast<uint32_t>(v);
+                ++i;
+            }
+            if (i == digits) {
+                return 0;
+            }
+            if (i < s.size() && s[i] == ';') {
+                ++i;
+            }
+            if (cp >= 0x80 && cp <= 0x9F) {
+                cp = windows1252C1()[cp - 0x80];   // as browsers do
+            }
+            else if (cp == 0 || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) {
+                cp = 0xFFFD;
+            }
+            appendCodePoint(sink, cp);
+            utf8_len = sink.n;
+            return i;
+        }
+
+        while (i < s.size() && i < 10 && ((s[i] >= 'a' && s[i] <= 'z') || (s[i] >= 'A' && s[i] <= 'Z') ||
+                                          (s[i] >= '0' && s[i] <= '9'))) {
+            ++i;
+        }
+        if (i == 1 || i >= s.size() || s[i] != ';') {
+            return 0;
+        }
+        uint32_t cp = 0;
+        if (!namedEntity(s.substr(1, i - 1), cp)) {
+            return 0;
+        }
+        appendCodePoint(sink, cp);
+        utf8_len = sink.n;
+        return i + 1;
+    }
+
+    // Plain runs are copied in bulk between the '&'s
+    template<typename Out>
+    void decodeEntities(std::string_view in, Out& out) {
+        size_t i = 0;
+        while (i < in.size()) {
+            const void* amp = std::memchr(in.data() + i, '&', in.size() - i);
+            const size_t end = amp ? static_cast<size_t>(static_cast<const char*>(amp) - in.data()) : in.size();
+            out.append(in.data() + i, end - i);
+            i = end;
+            if (i < in.size()) {
+                char utf8[4];
+                size_t len = 0;
+                const size_t used = characterReference(in.substr(i), utf8, len);
+                if (used) {
+                    out.append(utf8, len);
+                    i += used;
+                }
+                else {
+                    out.append("&", 1);
+                    ++i;
+                }
+            }
+        }
+    }
+
+}
+
+
+enum class TokenType { StartTag, EndTag, Text, Comment, Doctype, End };
+
+struct HtmlAttribute {
+    std::string_view name;
+    std::string_view value;
+};
+
+// Views point into the tokenized input, which must outlive the token.
+// name is lower-cased into a buffer that is reused from token to token.
+struct HtmlToken {
+    TokenType type = TokenType::End;
+    std::string name;
+    std::string_view text;
+    std::vector<HtmlAttribute> attributes;
+    bool selfClosing = false;
+
+    std::string_view attribute(std::string_view attr_name) const {
+        for (const auto& a : attributes) {
+            if (ParserUtils::iequals(a.name, attr_name)) {
+                return a.value;
+            }
+        }
+        return {};
+    }
+};
+
+
+class HtmlTokenizer {
+
+    public:
+
+        explicit HtmlTokenizer(std::string_view html) : html_(html) {}
+
+        // Returns false once the input is exhausted (token.type is then End)
+        bool next(HtmlToken& token) {
+
+            token.attributes.clear();
+            token.selfClosing = false;
+            token.text = {};
+
+            if (!raw_end_tag_.empty()) {
+                return rawText(token);
+            }
+
+            if (pos_ >= html_.size()) {
+                token.type = TokenType::End;
+                token.name.clear();
+                return false;
+            }
+
+            if (html_[pos_] != '<' || !tagStartsAt(pos_)) {
+                return text(token);
+            }
+
+            const char c = html_[pos_ + 1];
+            if (c == '!') {
+                if (html_.compare(pos_, 4, "<!--") == 0) {
+                    return comment(token);
+                }
+                return declaration(token, TokenType::Doctype);
+            }
+            if (c == '?') {
+                return declaration(token, TokenType::Comment);
+            }
+            return tag(token);
+        }
+
+    private:
+
+        bool tagStartsAt(size_t p) const {
+            if (p + 1 >= html_.size()) {
+                return false;
+            }
+            const char c = html_[p + 1];
+            return c == '!' || c == '?' || c == '/' ||
+                   (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+        }
+
+        bool text(HtmlToken& token) {
+            size_t end = pos_ + 1;
+            while (true) {
+                const void* hit = std::memchr(html_.data() + end, '<', html_.size() - end);
+                if (!hit) {
+                    end = html_.size();
+                    break;
+                }
+                end = static_cast<size_t>(static_cast<const char*>(hit) - html_.data());
+                if (tagStartsAt(end)) {
+                    break;
+                }
+                ++end;
+            }
+            token.type = TokenType::Text;
+            token.name.clear();
+            token.text = html_.substr(pos_, end - pos_);
+            pos_ = end;
+            return true;
+        }
+
+        // script/style/textarea/title content runs until the matching end tag
+        bool rawText(HtmlToken& token) {
+            size_t end = pos_;
+            while (true) {
+                end = html_.find("</", end);
+                if (end == std::string_view::npos) {
+                    end = html_.size();
+                    break;
+                }
+                if (ParserUtils::iequals(html_.substr(end + 2, raw_end_tag_.size()), raw_end_tag_)) {
+                    break;
+                }
+                end += 2;
+            }
+            raw_end_tag_.clear();
+            if (end == pos_) {
+                return next(token);
+            }
+            token.type = TokenType::Text;
+            token.name.clear();
+            token.text = html_.substr(pos_, end - pos_);
+            pos_ = end;
+            return true;
+        }
+
+        bool comment(HtmlToken& token) {
+            const size_t body = pos_ + 4;
+            size_t end = html_.find("-->", body);
+            token.type = TokenType::Comment;
+            token.name.clear();
+            if (end == std::string_view::npos) {
+                token.text = html_.substr(body);
+                pos_ = html_.size();
+            }
+            else {
+                token.text = html_.substr(body, end - body);
+                pos_ = end + 3;
+            }
+            return true;
+        }
+
+        bool declaration(HtmlToken& token, TokenType type) {
+            const size_t body = pos_ + 2;
+            size_t end = html_.find('>', body);
+            if (end == std::string_view::npos) {
+                end = html_.size();
+            }
+            token.type = type;
+            token.name.clear();
+            token.text = html_.substr(body, end - body);
+            pos_ = end < html_.size() ? end + 1 : end;
+            return true;
+        }
+
+        bool tag(HtmlToken& token) {
+
+            size_t p = pos_ + 1;
+            token.type = TokenType::StartTag;
+            if (html_[p] == '/') {
+                token.type = TokenType::EndTag;
+                ++p;
+            }
+
+            token.name.clear();
+            while (p < html_.size() && !ParserUtils::isSpace(html_[p]) && html_[p] != '>' && html_[p] != '/') {
+                token.name.push_back(ParserUtils::toLower(html_[p]));
+                ++p;
+            }
+
+            while (p < html_.size()) {
+                while (p < html_.size() && (ParserUtils::isSpace(html_[p]) || html_[p] == '/')) {
+                    if (html_[p] == '/' && p + 1 < html_.size() && html_[p + 1] == '>') {
+                        token.selfClosing = true;
+                    }
+                    ++p;
+                }
+                if (p >= html_.size() || html_[p] == '>') {
+                    break;
+                }
+
+                const size_t name_start = p;
+                while (p < html_.size() && !ParserUtils::isSpace(html_[p]) && html_[p] != '>' &&
+                       html_[p] != '=' && !(html_[p] == '/' && p > name_start)) {
+                    ++p;
+                }
+                HtmlAttribute attr;
+                attr.name = html_.substr(name_start, p - name_start);
+
+                while (p < html_.size() && ParserUtils::isSpace(html_[p])) {
+                    ++p;
+                }
+                if (p < html_.size() && html_[p] == '=') {
+                    ++p;
+                    while (p < html_.size() && ParserUtils::isSpace(html_[p])) {
+                        ++p;
+                    }
+                    if (p < html_.size() && (html_[p] == '"' || html_[p] == '\'')) {
+                        const char quote = html_[p++];
+                        size_t end = html_.find(quote, p);
+                        if (end == std::string_view::npos) {
+                            end = html_.size();
+                        }
+                        attr.value = html_.substr(p, end - p);
+                        p = end < html_.size() ? end + 1 : end;
+                    }
+                    else {
+                        const size_t value_start = p;
+                        while (p < html_.size() && !ParserUtils::isSpace(html_[p]) && html_[p] != '>') {
+                            ++p;
+                        }
+                        attr.value = html_.substr(value_start, p - value_start);
+                    }
+                }
+                if (token.type == TokenType::StartTag) {
+                    token.attributes.push_back(attr);
+                }
+            }
+
+            pos_ = p < html_.size() ? p + 1 : p;
+
+            if (token.type == TokenType::StartTag && !token.selfClosing &&
+                (token.name == "script" || token.name == "style" ||
+                 token.name == "textarea" || token.name == "title")) {
+                raw_end_tag_ = token.name;
+            }
+            return true;
+        }
+
+        std::string_view html_;
+        size_t pos_ = 0;
+        std::string raw_end_tag_;
+
+};
+
+
+// Builds Node trees from HTML. parse() keeps no state, so parse tasks on the pool can share
+// the instance.
 class Parser {
 
 
@@ -33,8 +486,96 @@ class Parser {
         Parser& operator=(const Parser&) = delete;
         Parser(const Parser&) = delete;
 
+        // The returned root is a "#document" element. Entities are decoded in text and attribute
+        // values (script and style text is kept as is), end tags close the nearest open element
+        // of that name, and a new p/li/dt/dd/option/tr/td/th closes an open sibling of its kind.
+        std::unique_ptr<Node> parse(std::string_view html) const {
 
+            auto root = std::make_unique<Node>();
+            root->type = NodeType::Element;
+            root->name = "#document";
 
+            std::vector<Node*> open{root.get()};
+            HtmlTokenizer tokenizer(html);
+            HtmlToken token;
+
+            while (tokenizer.next(token)) {
+                Node* parent = open.back();
+                switch (token.type) {
+                    case TokenType::StartTag: {
+                        if (open.size() > 1 && parent->name == token.name && closesSibling(token.name)) {
+                            open.pop_back();
+                            parent = open.back();
+                        }
+                        Node* node = appendChild(parent, NodeType::Element);
+                        node->name = token.name;
+                        for (const HtmlAttribute& attr : token.attributes) {
+                            std::string name;
+                            for (char c : attr.name) {
+                                name.push_back(ParserUtils::toLower(c));
+                            }
+                            if (node->attributes.count(name)) {
+                                continue;
+                            }
+                            std::string value;
+                            ParserUtils::decodeEntities(attr.value, value);
+                            node->attributes.emplace(std::move(name), std::move(value));
+                        }
+                        // beyond the depth limit elements become siblings, which keeps the
+                        // recursive Node destructor off deep stacks
+                        if (!token.selfClosing && !isVoid(token.name) && open.size() < max_depth_) {
+                            open.push_back(node);
+                        }
+                        break;
+                    }
+                    case TokenType::EndTag:
+                        for (size_t i = open.size(); i-- > 1;) {
+                            if (open[i]->name == token.name) {
+                                open.resize(i);
+                                break;
+                            }
+                        }
+                        break;
+                    case TokenType::Text: {
+                        Node* node = appendChild(parent, NodeType::Text);
+                        if (parent->name == "script" || parent->name == "style") {
+                            node->text.assign(token.text);
+                        }
+                        else {
+                            ParserUtils::decodeEntities(token.text, node->text);
+                        }
+                        break;
+                    }
+                    case TokenType::Comment:
+                        appendChild(parent, NodeType::Comment)->text.assign(token.text);
+                        break;
+                    default:
+                        break;
+                }
+            }
+
+            return root;
+        }
+
+        // Each page is parsed in its own pool task and handed to handler there, so extraction
+        // or selector matching runs on the fresh tree before it is freed. Returns the tasks queued.
+        using TreeHandler = std::function<void(size_t index, const Node& root)>;
+
+        size_t parseBatch(std::vector<std::string> pages, TreeHandler handler) {
+            auto batch = std::make_shared<std::vector<std::string>>(std::move(pages));
+            auto callback = std::make_shared<TreeHandler>(std::move(handler));
+            size_t queued = 0;
+            for (size_t i = 0; i < batch->size(); ++i) {
+                if (!pool_.enqueue([this, batch, callback, i]() {
+                        std::unique_ptr<Node> root = parse((*batch)[i]);
+                        (*callback)(i, *root);
+                    })) {
+                    break;
+                }
+                ++queued;
+            }
+            return queued;
+        }
 
     private:
 
@@ -42,8 +583,34 @@ class Parser {
 
         }
 
-        std::vector<Node> stack_;
+        static Node* appendChild(Node* parent, NodeType type) {
+            parent->children.push_back(std::make_unique<Node>());
+            Node* node = parent->children.back().get();
+            node->type = type;
+            node->parent = parent;
+            return node;
+        }
+
+        static bool isVoid(std::string_view name) {
+            static const std::string_view names[] = {
+                "area", "base", "br", "col", "embed", "hr", "img", "input",
+                "link", "meta", "param", "source", "track", "wbr"
+            };
+            for (std::string_view n : names) {
+                if (n == name) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        static bool closesSibling(std::string_view name) {
+            return name == "p" || name == "li" || name == "dt" || name == "dd" ||
+                   name == "option" || name == "tr" || name == "td" || name == "th";
+        }
+
         ThreadPool& pool_;
+        size_t max_depth_ = 512;
 
 
 
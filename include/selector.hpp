@@ -0,0 +1,538 @@
+#ifndef SELECTOR_HPP
+#define SELECTOR_HPP
+
+#include "parser.hpp"
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+
+namespace SelectorUtils {
+
+    inline uint64_t hash(std::string_view s) {
+        uint64_t h = 14695981039346656037ull;
+        for (char c : s) {
+            h ^= static_cast<unsigned char>(c);
+            h *= 1099511628211ull;
+        }
+        return h;
+    }
+
+    // One bit of a 64-bit filter per tag, id or class
+    inline uint64_t bit(uint64_t h) {
+        return 1ull << (h >> 58);
+    }
+
+    inline bool isNameChar(char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+               c == '-' || c == '_' || static_cast<unsigned char>(c) >= 0x80;
+    }
+
+    enum class AttributeOp { Exists, Equals, Includes, DashMatch, Prefix, Suffix, Substring };
+
+    inline bool attributeMatches(AttributeOp op, std::string_view value, std::string_view wanted) {
+        switch (op) {
+            case AttributeOp::Exists:
+                return true;
+            case AttributeOp::Equals:
+                return value == wanted;
+            case AttributeOp::Includes: {
+                size_t p = 0;
+                while (p < value.size()) {
+                    while (p < value.size() && ParserUtils::isSpace(value[p])) ++p;
+                    size_t e = p;
+                    while (e < value.size() && !ParserUtils::isSpace(value[e])) ++e;
+                    if (e > p && value.substr(p, e - p) == wanted) {
+                        return true;
+                    }
+                    p = e;
+                }
+                return false;
+            }
+            case AttributeOp::DashMatch:
+                return value == wanted || (value.size() > wanted.size() && value[wanted.size()] == '-' &&
+                                           value.compare(0, wanted.size(), wanted) == 0);
+            case AttributeOp::Prefix:
+                return !wanted.empty() && value.compare(0, wanted.size(), wanted) == 0;
+            case AttributeOp::Suffix:
+                return !wanted.empty() && value.size() >= wanted.size() &&
+                       value.compare(value.size() - wanted.size(), wanted.size(), wanted) == 0;
+            case AttributeOp::Substring:
+                return !wanted.empty() && value.find(wanted) != std::string_view::npos;
+        }
+        return false;
+    }
+
+}
+
+
+// CSS selectors compiled once and matched together in a single pass over a Node tree.
+// Supported: type and universal selectors, #id, .class, [attr], [attr=v], [attr~=v],
+// [attr|=v], [attr^=v], [attr$=v], [attr*=v], descendant and child (>) combinators, and
+// comma-separated lists. Selectors are bucketed by the id, class or tag of their rightmost
+// compound, as browsers do, so an element only tries the selectors that could match it;
+// a 64-bit filter of the ancestors' tags, ids and classes rejects most of the rest before
+// any ancestor is visited. A compiled set is read-only while matching and can be shared
+// by parse tasks on the pool.
+class SelectorSet {
+
+    public:
+
+        SelectorSet() = default;
+
+        // Returns the index reported for matches of this selector, -1 if it does not parse;
+        // error() then says where
+        int add(std::string_view selector) {
+            std::vector<Program> programs;
+            size_t p = 0;
+            while (true) {
+                Program program;
+                program.index = static_cast<int>(count_);
+                if (!compile(selector, p, program)) {
+                    error_position_ = p < selector.size() ? p : selector.size();
+                    error_ = error_position_ < selector.size()
+                                 ? "unexpected '" + std::string(1, selector[error_position_]) + "'"
+                                 : std::string("unexpected end");
+                    error_ += " at offset " + std::to_string(error_position_);
+                    return -1;
+                }
+                programs.push_back(std::move(program));
+                if (p >= selector.size()) {
+                    break;
+                }
+                ++p; // ','
+            }
+            for (Program& program : programs) {
+                bucket(std::move(program));
+            }
+            error_.clear();
+            error_position_ = 0;
+            return static_cast<int>(count_++);
+        }
+
+        // Why the last add() failed, e.g. "unexpected ':' at offset 1"; empty after a success
+        const std::string& error() const {
+            return error_;
+        }
+
+        size_t errorPosition() const {
+            return error_position_;
+        }
+
+        size_t size() const {
+            return count_;
+        }
+
+        // Calls fn(index, node) for every element matching a selector, elements in document
+        // order. An element matching several comma-separated parts of one selector is
+        // reported once.
+        template<typename F>
+        void match(const Node& root, F fn) const {
+
+            std::vector<Element> stack;
+            std::vector<uint64_t> classes;
+            std::vector<int> candidates;
+            std::vector<size_t> reported(count_, static_cast<size_t>(-1));
+            size_t visited = 0;
+
+            // iterative pre-order walk; frames hold the next child to visit
+            struct Frame {
+                const Node* node;
+                size_t next;
+            };
+            std::vector<Frame> frames{{&root, 0}};
+
+            while (!frames.empty()) {
+                Frame& frame = frames.back();
+                if (frame.next == frame.node->children.size()) {
+                    if (frame.node != &root && frame.node->type == NodeType::Element) {
+                        classes.resize(stack.back().classes_begin);
+                        stack.pop_back();
+                    }
+                    frames.pop_back();
+                    continue;
+                }
+                const Node* node = frame.node->children[frame.next++].get();
+                if (node->type != NodeType::Element) {
+                    continue;
+                }
+
+                stack.push_back(describe(*node, classes, stack.empty() ? 0 : stack.back().filter));
+                const Element& element = stack.back();
+                ++visited;
+
+                candidates.clear();
+                if (!element.id.empty()) {
+                    collect(by_id_, element.id_hash, candidates);
+                }
+                for (size_t c = element.classes_begin; c < element.classes_end; ++c) {
+                    collect(by_class_, classes[c], candidates);
+                }
+                collect(by_tag_, element.tag_hash, candidates);
+                for (size_t i = 0; i < universal_.size(); ++i) {
+                    candidates.push_back(static_cast<int>(i) | kUniversal);
+                }
+
+                for (int candidate : candidates) {
+                    const Program& program = (candidate & kUniversal) ? universal_[candidate & ~kUniversal]
+                                                                       : programs_[candidate];
+                    if (reported[program.index] == visited) {
+                        continue;
+                    }
+                    const uint64_t ancestors = stack.size() > 1 ? stack[stack.size() - 2].filter : 0;
+                    if ((ancestors & program.ancestor_filter) != program.ancestor_filter) {
+                        continue;
+                    }
+                    if (matches(program.compounds[0], element, classes) &&
+                        matchesLeft(program, 0, stack.size() - 1, stack, classes)) {
+                        reported[program.index] = visited;
+                        fn(program.index, *node);
+                    }
+                }
+
+                frames.push_back(Frame{node, 0});
+            }
+        }
+
+        // Matches of every selector, each list in document order
+        std::vector<std::vector<const Node*>> matchAll(const Node& root) const {
+            std::vector<std::vector<const Node*>> out(count_);
+            match(root, [&out](int index, const Node& node) {
+                out[index].push_back(&node);
+            });
+            return out;
+        }
+
+    private:
+
+        static constexpr int kUniversal = 1 << 30;
+
+        enum class Combinator { Descendant, Child };
+
+        struct AttributeTest {
+            std::string name;
+            SelectorUtils::AttributeOp op;
+            std::string value;
+        };
+
+        struct Compound {
+            std::string tag;                    // empty for any
+            uint64_t tag_hash = 0;
+            std::string id;
+            uint64_t id_hash = 0;
+            std::vector<std::string> classes;
+            std::vector<uint64_t> class_hashes;
+            uint64_t class_filter = 0;
+            std::vector<AttributeTest> attributes;
+            Combinator combinator = Combinator::Descendant;   // towards the compound on its left
+        };
+
+        // Compounds right to left
+        struct Program {
+            int index = 0;
+            std::vector<Compound> compounds;
+            uint64_t ancestor_filter = 0;
+        };
+
+        // What matching needs of an element, worked out once per element
+        struct Element {
+            const Node* node;
+            uint64_t tag_hash;
+            std::string_view id;
+            uint64_t id_hash;
+            size_t classes_begin;       // its class hashes in the shared classes vector
+            size_t classes_end;
+            uint64_t class_filter;
+            uint64_t filter;            // own and ancestors' bits
+        };
+
+        static Element describe(const Node& node, std::vector<uint64_t>& classes, uint64_t parent_filter) {
+            Element e;
+            e.node = &node;
+            e.tag_hash = SelectorUtils::hash(node.name);
+            e.id = {};
+            e.id_hash = 0;
+            e.classes_begin = classes.size();
+            e.classes_end = classes.size();
+            e.class_filter = 0;
+            e.filter = parent_filter | SelectorUtils::bit(e.tag_hash);
+            if (node.attributes.empty()) {
+                return e;
+            }
+            auto id = node.attributes.find("id");
+            if (id != node.attributes.end() && !id->second.empty()) {
+                e.id = id->second;
+                e.id_hash = SelectorUtils::hash(e.id);
+                e.filter |= SelectorUtils::bit(e.id_hash);
+            }
+            auto cls = node.attributes.find("class");
+            if (cls != node.attributes.end()) {
+                std::string_view v = cls->second;
+                size_t p = 0;
+                while (p < v.size()) {
+                    while (p < v.size() && ParserUtils::isSpace(v[p])) ++p;
+                    size_t end = p;
+                    while (end < v.size() && !ParserUtils::isSpace(v[end])) ++end;
+                    if (end > p) {
+                        const uint64_t h = SelectorUtils::hash(v.substr(p, end - p));
+                        classes.push_back(h);
+                        e.class_filter |= SelectorUtils::bit(h);
+                    }
+                    p = end;
+                }
+                e.filter |= e.class_filter;
+            }
+            e.classes_end = classes.size();
+            return e;
+        }
+
+        static bool matches(const Compound& c, const Element& e, const std::vector<uint64_t>& classes) {
+            if (!c.tag.empty() && (c.tag_hash != e.tag_hash || c.tag != e.node->name)) {
+                return false;
+            }
+            if (!c.id.empty() && (c.id_hash != e.id_hash || c.id != e.id)) {
+                return false;
+            }
+            if ((e.class_filter & c.class_filter) != c.class_filter) {
+                return false;
+            }
+            for (uint64_t h : c.class_hashes) {
+                bool found = false;
+                for (size_t i = e.classes_begin; i < e.classes_end && !found; ++i) {
+                    found = classes[i] == h;
+                }
+                if (!found) {
+                    return false;
+                }
+            }
+            for (const AttributeTest& a : c.attributes) {
+                auto it = e.node->attributes.find(a.name);
+                if (it == e.node->attributes.end() || !SelectorUtils::attributeMatches(a.op, it->second, a.value)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // compounds[k] matched stack[depth]; checks the compounds to its left against ancestors
+        static bool matchesLeft(const Program& program, size_t k, size_t depth, const std::vector<Element>& stack,
+                                const std::vector<uint64_t>& classes) {
+            if (k + 1 == program.compounds.size()) {
+                return true;
+            }
+            const Compound& left = program.compounds[k + 1];
+            auto test = [&](size_t d) {
+                return matches(left, stack[d], classes) && matchesLeft(program, k + 1, d, stack, classes);
+            };
+            if (program.compounds[k].combinator == Combinator::Child) {
+                return depth > 0 && test(depth - 1);
+            }
+            for (size_t d = depth; d-- > 0;) {
+                if (test(d)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        static void collect(const std::unordered_map<uint64_t, std::vector<int>>& buckets, uint64_t key,
+                            std::vector<int>& out) {
+            auto it = buckets.find(key);
+            if (it != buckets.end()) {
+                out.insert(out.end(), it->second.begin(), it->second.end());
+            }
+        }
+
+        void bucket(Program&& program) {
+            const Compound& right = program.compounds[0];
+            for (size_t k = 1; k < program.compounds.size(); ++k) {
+                const Compound& c = program.compounds[k];
+                if (!c.tag.empty()) program.ancestor_filter |= SelectorUtils::bit(c.tag_hash);
+                if (!c.id.empty()) program.ancestor_filter |= SelectorUtils::bit(c.id_hash);
+                program.ancestor_filter |= c.class_filter;
+            }
+            if (!right.id.empty()) {
+                by_id_[right.id_hash].push_back(static_cast<int>(programs_.size()));
+            }
+            else if (!right.class_hashes.empty()) {
+                by_class_[right.class_hashes[0]].push_back(static_cast<int>(programs_.size()));
+            }
+            else if (!right.tag.empty()) {
+                by_tag_[right.tag_hash].push_back(static_cast<int>(programs_.size()));
+            }
+            else {
+                universal_.push_back(std::move(program));
+                return;
+            }
+            programs_.push_back(std::move(program));
+        }
+
+        static void skipSpace(std::string_view s, size_t& p) {
+            while (p < s.size() && ParserUtils::isSpace(s[p])) {
+                ++p;
+            }
+        }
+
+        static bool name(std::string_view s, size_t& p, std::string& out) {
+            out.clear();
+            while (p < s.size()) {
+                if (s[p] == '\\' && p + 1 < s.size()) {
+                    out.push_back(s[p + 1]);
+                    p += 2;
+                }
+                else if (SelectorUtils::isNameChar(s[p])) {
+                    out.push_back(s[p++]);
+                }
+                else {
+                    break;
+                }
+            }
+            return !out.empty();
+        }
+
+        static bool attribute(std::string_view s, size_t& p, AttributeTest& test) {
+            ++p; // '['
+            skipSpace(s, p);
+            if (!name(s, p, test.name)) {
+                return false;
+            }
+            for (char& c : test.name) {
+                c = ParserUtils::toLower(c);
+            }
+            skipSpace(s, p);
+            test.op = SelectorUtils::AttributeOp::Exists;
+            if (p < s.size() && s[p] != ']') {
+                using SelectorUtils::AttributeOp;
+                const char c = s[p];
+                if (c == '=') {
+                    test.op = AttributeOp::Equals;
+                }
+                else if (p + 1 < s.size() && s[p + 1] == '=') {
+                    switch (c) {
+                        case '~': test.op = AttributeOp::Includes; break;
+                        case '|': test.op = AttributeOp::DashMatch; break;
+                        case '^': test.op = AttributeOp::Prefix; break;
+                        case '$': test.op = AttributeOp::Suffix; break;
+                        case '*': test.op = AttributeOp::Substring; break;
+                        default: return false;
+                    }
+                    ++p;
+                }
+                else {
+                    return false;
+                }
+                ++p;
+                skipSpace(s, p);
+                if (p < s.size() && (s[p] == '"' || s[p] == '\'')) {
+                    const char quote = s[p++];
+                    const size_t end = s.find(quote, p);
+                    if (end == std::string_view::npos) {
+                        return false;
+                    }
+                    test.value.assign(s.substr(p, end - p));
+                    p = end + 1;
+                }
+                else if (!name(s, p, test.value)) {
+                    return false;
+                }
+                skipSpace(s, p);
+            }
+            if (p >= s.size() || s[p] != ']') {
+                return false;
+            }
+            ++p;
+            return true;
+        }
+
+        // One complex selector from s[p] up to ',' or the end
+        static bool compile(std::string_view s, size_t& p, Program& program) {
+
+            std::vector<Compound> compounds;
+            Combinator combinator = Combinator::Descendant;
+            skipSpace(s, p);
+
+            while (true) {
+                Compound c;
+                bool any = false;
+                std::string text;
+
+                if (p < s.size() && s[p] == '*') {
+                    ++p;
+                    any = true;
+                }
+                else if (name(s, p, text)) {
+                    for (char& ch : text) {
+                        ch = ParserUtils::toLower(ch);
+                    }
+                    c.tag = text;
+                    c.tag_hash = SelectorUtils::hash(c.tag);
+                    any = true;
+                }
+                while (p < s.size()) {
+                    if (s[p] == '#') {
+                        ++p;
+                        if (!name(s, p, c.id)) return false;
+                        c.id_hash = SelectorUtils::hash(c.id);
+                    }
+                    else if (s[p] == '.') {
+                        ++p;
+                        if (!name(s, p, text)) return false;
+                        c.classes.push_back(text);
+                        c.class_hashes.push_back(SelectorUtils::hash(text));
+                        c.class_filter |= SelectorUtils::bit(c.class_hashes.back());
+                    }
+                    else if (s[p] == '[') {
+                        AttributeTest test;
+                        if (!attribute(s, p, test)) return false;
+                        c.attributes.push_back(std::move(test));
+                    }
+                    else {
+                        break;
+                    }
+                    any = true;
+                }
+                if (!any) {
+                    return false; // includes pseudo-classes and the + and ~ combinators
+                }
+                c.combinator = combinator;
+                compounds.push_back(std::move(c));
+
+                const size_t before = p;
+                skipSpace(s, p);
+                if (p >= s.size() || s[p] == ',') {
+                    break;
+                }
+                if (s[p] == '>') {
+                    combinator = Combinator::Child;
+                    ++p;
+                    skipSpace(s, p);
+                }
+                else if (p > before) {
+                    combinator = Combinator::Descendant;
+                }
+                else {
+                    return false;
+                }
+            }
+
+            // stored right to left; each compound keeps the combinator to its left neighbour
+            program.compounds.assign(std::make_move_iterator(compounds.rbegin()),
+                                     std::make_move_iterator(compounds.rend()));
+            return true;
+        }
+
+        std::vector<Program> programs_;
+        std::vector<Program> universal_;
+        std::unordered_map<uint64_t, std::vector<int>> by_id_;
+        std::unordered_map<uint64_t, std::vector<int>> by_class_;
+        std::unordered_map<uint64_t, std::vector<int>> by_tag_;
+        size_t count_ = 0;
+        std::string error_;
+        size_t error_position_ = 0;
+
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,786 @@
+#ifndef SITEMAP_HPP
+#define SITEMAP_HPP
+
+#include "url.hpp"
+#include <curl/curl.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+// .xml.gz sitemaps are inflated when built with SITEMAP_GZIP (set by CMake when it finds
+// zlib, which the target then links); otherwise they are rejected with an error
+#ifdef SITEMAP_GZIP
+#include <zlib.h>
+#endif
+
+
+struct SitemapEntry {
+    std::string loc;
+    std::string lastmod;   // W3C datetime as published, may be empty
+    double priority = -1.0; // <priority> in [0, 1], -1 if absent
+};
+
+struct SitemapStats {
+    uint64_t sitemaps_loaded = 0;
+    uint64_t sitemaps_failed = 0;
+    uint64_t indexes = 0;
+    uint64_t urls = 0;
+    uint64_t batches = 0;
+    uint64_t bytes_read = 0;    // as fetched, compressed if it was
+    uint64_t bytes_xml = 0;     // after inflating
+    double seconds = 0.0;
+};
+
+
+namespace SitemapUtils {
+
+    enum class EntryType {Url, Sitemap};
+
+    // Days since 1970-01-01 for a proleptic Gregorian date
+    inline long daysFromCivil(int y, unsigned m, unsigned d) {
+        y -= m <= 2;
+        const long era = (y >= 0 ? y : y - 399) / 400;
+        const unsigned yoe = static_cast<unsigned>(y - era * 400);
+        const unsigned doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+        const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+        return era * 146097 + static_cast<long>(doe) - 719468;
+    }
+
+    // Date part of a W3C datetime ("YYYY", "YYYY-MM" or "YYYY-MM-DD..."), -1 if unparsable
+    inline long lastmodDays(std::string_view s) {
+        auto digits = [&](size_t pos, size_t n) {
+            int v = 0;
+            for (size_t i = pos; i < pos + n; ++i) {
+                if (i >= s.size() || s[i] < '0' || s[i] > '9') {
+                    return -1;
+                }
+                v = v * 10 + (s[i] - '0');
+            }
+            return v;
+        };
+        const int y = digits(0, 4);
+        if (y < 0) {
+            return -1;
+        }
+        int m = 1;
+        int d = 1;
+        if (s.size() >= 7 && s[4] == '-') {
+            m = digits(5, 2);
+            if (s.size() >= 10 && s[7] == '-') {
+                d = digits(8, 2);
+            }
+        }
+        if (m < 1 || m > 12 || d < 1 || d > 31) {
+            return -1;
+        }
+        return daysFromCivil(y, static_cast<unsigned>(m), static_cast<unsigned>(d));
+    }
+
+    inline long todayDays() {
+        using namespace std::chrono;
+        return static_cast<long>(duration_cast<hours>(system_clock::now().time_since_epoch()).count() / 24);
+    }
+
+    // Frontier priority for a sitemap URL: the published <priority> (0.5 when absent, as the
+    // protocol says), scaled down by up to a half as <lastmod> ages over about a year
+    inline double seedPriority(const SitemapEntry& e, long today = todayDays()) {
+        double p = (e.priority >= 0.0 && e.priority <= 1.0) ? e.priority : 0.5;
+        const long days = e.lastmod.empty() ? -1 : lastmodDays(e.lastmod);
+        double freshness = 0.5;
+        if (days >= 0) {
+            freshness = std::exp(-std::max(0L, today - days) / 365.0);
+        }
+        return std::max(0.01, p) * (0.5 + 0.5 * freshness);
+    }
+
+    inline void trim(std::string& s) {
+        size_t b = 0;
+        while (b < s.size() && (s[b] == ' ' || s[b] == '\t' || s[b] == '\n' || s[b] == '\r')) {
+            ++b;
+        }
+        size_t e = s.size();
+        while (e > b && (s[e - 1] == ' ' || s[e - 1] == '\t' || s[e - 1] == '\n' || s[e - 1] == '\r')) {
+            --e;
+        }
+        if (b > 0 || e < s.size()) {
+            s = s.substr(b, e - b);
+        }
+    }
+
+    inline void appendUtf8(std::string& out, uint32_t cp) {
+        if (cp < 0x80) {
+            out.push_back(static_cast<char>(cp));
+        }
+        else if (cp < 0x800) {
+            out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+            out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+        }
+        else if (cp < 0x10000) {
+            out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+            out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+        }
+        else if (cp < 0x110000) {
+            out.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+            out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+        }
+    }
+
+    // The five XML entities and numeric references, in place
+    inline void decodeEntities(std::string& s) {
+        if (s.find('&') == std::string::npos) {
+            return;
+        }
+        std::string out;
+        out.reserve(s.size());
+        for (size_t i = 0; i < s.size(); ++i) {
+            if (s[i] != '&') {
+                out.push_back(s[i]);
+                continue;
+            }
+            size_t semi = s.find(';', i + 1);
+            if (semi == std::string::npos || semi - i > 10) {
+                out.push_back('&');
+                continue;
+            }
+            std::string_view name(s.data() + i + 1, semi - i - 1);
+            if (name == "amp") out.push_back('&');
+            else if (name == "lt") out.push_back('<');
+            else if (name == "gt") out.push_back('>');
+            else if (name == "quot") out.push_back('"');
+            else if (name == "apos") out.push_back('\'');
+            else if (name.size() > 1 && name[0] == '#') {
+                const bool hex = name[1] == 'x' || name[1] == 'X';
+                std::string num(name.substr(hex ? 2 : 1));
+                char* end = nullptr;
+                unsigned long cp = std::strtoul(num.c_str(), &end, hex ? 16 : 10);
+                if (num.empty() || *end != '\0') {
+                    out.push_back('&');
+                    continue;
+                }
+                appendUtf8(out, static_cast<uint32_t>(cp));
+            }
+            else {
+                out.push_back('&');
+                continue;
+            }
+            i = semi;
+        }
+        s.swap(out);
+    }
+
+}
+
+
+// Push parser for <urlset> and <sitemapindex> documents. Input may be cut anywhere; memory
+// stays bounded by the longest single entry no matter how large the document is.
+class SitemapParser {
+
+    public:
+
+        using EntryHandler = std::function<void(SitemapEntry&& entry, SitemapUtils::EntryType type)>;
+
+        explicit SitemapParser(EntryHandler handler) : handler_(std::move(handler)) {}
+
+        bool isIndex() const {
+            return index_;
+        }
+
+        void feed(const char* data, size_t n) {
+
+            const char* p = data;
+            const char* end = data + n;
+
+            while (p < end) {
+                switch (state_) {
+
+                    case State::Text: {
+                        const char* lt = static_cast<const char*>(std::memchr(p, '<', end - p));
+                        const char* stop = lt ? lt : end;
+                        if (field_ != Field::None) {
+                            appendText(p, stop - p);
+                        }
+                        p = stop;
+                        if (lt) {
+                            ++p;
+                            tag_.clear();
+                            closing_ = false;
+                            state_ = State::TagStart;
+                        }
+                        break;
+                    }
+
+                    case State::TagStart: {
+                        const char c = *p++;
+                        if (c == '/') {
+                            closing_ = true;
+                            state_ = State::TagName;
+                        }
+                        else if (c == '!') {
+                            state_ = State::Bang;
+                        }
+                        else if (c == '?') {
+                            question_ = false;
+                            state_ = State::Pi;
+                        }
+                        else {
+                            tag_.push_back(c);
+                            state_ = State::TagName;
+                        }
+                        break;
+                    }
+
+                    case State::TagName: {
+                        const char c = *p++;
+                        if (c == '>' || c == '/' || c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+                            self_closing_ = c == '/';
+                            quote_ = 0;
+                            if (c == '>') {
+                                endTag();
+                            }
+                            else {
+                                state_ = State::TagRest;
+                            }
+                        }
+                        else if (tag_.size() < 64) {
+                            tag_.push_back(c);
+                        }
+                        break;
+                    }
+
+                    case State::TagRest: {
+                        // attributes are skipped, but a '>' inside a quoted value does not end the tag
+                        const char c = *p++;
+                        if (quote_) {
+                            if (c == quote_) {
+                                quote_ = 0;
+                            }
+                        }
+                        else if (c == '"' || c == '\'') {
+                            quote_ = c;
+                        }
+                        else if (c == '>') {
+                            endTag();
+                        }
+                        else {
+                            self_closing_ = c == '/';
+                        }
+                        break;
+                    }
+
+                    case State::Bang: {
+                        // "<!--", "<![CDATA[" or some other declaration
+                        tag_.push_back(*p++);
+                        if (tag_ == "--") {
+                            dashes_ = 0;
+                            state_ = State::Comment;
+                        }
+                        else if (tag_ == "[CDATA[") {
+                            brackets_ = 0;
+                            state_ = State::Cdata;
+                        }
+                        else if (std::string_view("--").substr(0, tag_.size()) != tag_ &&
+                                 std::string_view("[CDATA[").substr(0, tag_.size()) != tag_) {
+                            state_ = tag_.back() == '>' ? State::Text : State::Decl;
+                        }
+                        break;
+                    }
+
+                    case State::Comment: {
+                        const char c = *p++;
+                        if (c == '>' && dashes_ >= 2) {
+                            state_ = State::Text;
+                        }
+                        dashes_ = c == '-' ? dashes_ + 1 : 0;
+                        break;
+                    }
+
+                    case State::Cdata: {
+                        const char c = *p++;
+                        if (c == '>' && brackets_ >= 2) {
+                            if (field_ != Field::None) {
+                                // the "]]" was appended as text, take it back
+                                field_text_.resize(field_text_.size() - std::min<size_t>(2, field_text_.size()));
+                            }
+                            state_ = State::Text;
+                            brackets_ = 0;
+                            break;
+                        }
+                        brackets_ = c == ']' ? brackets_ + 1 : 0;
+                        if (field_ != Field::None) {
+                            appendText(&c, 1);
+                        }
+                        break;
+                    }
+
+                    case State::Pi: {
+                        const char c = *p++;
+                        if (c == '>' && question_) {
+                            state_ = State::Text;
+                        }
+                        question_ = c == '?';
+                        break;
+                    }
+
+                    case State::Decl: {
+                        if (*p++ == '>') {
+                            state_ = State::Text;
+                        }
+                        break;
+                    }
+                }
+            }
+        }
+
+    private:
+
+        enum class State {Text, TagStart, TagName, TagRest, Bang, Comment, Cdata, Pi, Decl};
+        enum class Field {None, Loc, Lastmod, Priority};
+
+        // longest <loc> worth keeping; sitemaps cap URLs at 2048 characters
+        static constexpr size_t max_field_ = 8192;
+
+        static std::string_view localName(std::string_view name) {
+            size_t colon = name.find(':');
+            return colon == std::string_view::npos ? name : name.substr(colon + 1);
+        }
+
+        void appendText(const char* p, size_t n) {
+            if (field_text_.size() + n > max_field_) {
+                overflow_ = true;
+                return;
+            }
+            field_text_.append(p, n);
+        }
+
+        void endTag() {
+
+            state_ = State::Text;
+            const std::string_view name = localName(tag_);
+
+            if (closing_) {
+                if (field_ != Field::None && depth_ == entry_depth_ + 2) {
+                    closeField();
+                }
+                if (in_entry_ && depth_ == entry_depth_ + 1 && (name == "url" || name == "sitemap")) {
+                    emit();
+                }
+                if (depth_ > 0) {
+                    --depth_;
+                }
+                return;
+            }
+
+            ++depth_;
+            if (depth_ == 1) {
+                index_ = name == "sitemapindex";
+            }
+            else if (!in_entry_ && depth_ == 2 && (name == "url" || name == "sitemap")) {
+                in_entry_ = true;
+                entry_depth_ = depth_ - 1;
+                entry_ = SitemapEntry();
+                entry_type_ = name == "url" ? SitemapUtils::EntryType::Url : SitemapUtils::EntryType::Sitemap;
+            }
+            else if (in_entry_ && depth_ == entry_depth_ + 2) {
+                // only direct children count, so <image:loc> and friends are ignored
+                if (name == "loc") field_ = Field::Loc;
+                else if (name == "lastmod") field_ = Field::Lastmod;
+                else if (name == "priority") field_ = Field::Priority;
+                field_text_.clear();
+                overflow_ = false;
+            }
+
+            if (self_closing_) {
+                self_closing_ = false;
+                closing_ = true;
+                endTag();
+            }
+        }
+
+        void closeField() {
+
+            if (!overflow_) {
+                SitemapUtils::trim(field_text_);
+                SitemapUtils::decodeEntities(field_text_);
+                switch (field_) {
+                    case Field::Loc:
+                        entry_.loc.swap(field_text_);
+                        break;
+                    case Field::Lastmod:
+                        entry_.lastmod.swap(field_text_);
+                        break;
+                    case Field::Priority: {
+                        char* end = nullptr;
+                        double v = std::strtod(field_text_.c_str(), &end);
+                        if (end != field_text_.c_str()) {
+                            entry_.priority = std::min(1.0, std::max(0.0, v));
+                        }
+                        break;
+                    }
+                    default:
+                        break;
+                }
+            }
+            field_ = Field::None;
+            field_text_.clear();
+        }
+
+        void emit() {
+            in_entry_ = false;
+            if (!entry_.loc.empty()) {
+                handler_(std::move(entry_), entry_type_);
+            }
+            entry_ = SitemapEntry();
+        }
+
+        EntryHandler handler_;
+
+        State state_ = State::Text;
+        std::string tag_;
+        bool closing_ = false;
+        bool self_closing_ = false;
+        char quote_ = 0;
+        int dashes_ = 0;
+        int brackets_ = 0;
+        bool question_ = false;
+
+        int depth_ = 0;
+        int entry_depth_ = 0;
+        bool index_ = false;
+        bool in_entry_ = false;
+        SitemapUtils::EntryType entry_type_ = SitemapUtils::EntryType::Url;
+        SitemapEntry entry_;
+        Field field_ = Field::None;
+        std::string field_text_;
+        bool overflow_ = false;
+
+};
+
+
+// Bytes of one sitemap file as they arrive: gzip is detected from the magic bytes and
+// inflated through a fixed window, then handed to the parser.
+class SitemapStream {
+
+    public:
+
+        explicit SitemapStream(SitemapParser::EntryHandler handler) : parser_(std::move(handler)) {}
+
+        SitemapStream(const SitemapStream&) = delete;
+        SitemapStream& operator=(const SitemapStream&) = delete;
+
+        ~SitemapStream() {
+#ifdef SITEMAP_GZIP
+            if (inflating_) {
+                inflateEnd(&zs_);
+            }
+#endif
+        }
+
+        bool write(const char* data, size_t n) {
+
+            if (failed_ || n == 0) {
+                return !failed_;
+            }
+
+            if (mode_ == Mode::Unknown) {
+                // two bytes decide it, and they may come in separate writes
+                while (head_len_ < 2 && n > 0) {
+                    head_[head_len_++] = *data++;
+                    --n;
+                }
+                if (head_len_ < 2) {
+                    return true;
+                }
+                const bool gzip = static_cast<unsigned char>(head_[0]) == 0x1f &&
+                                  static_cast<unsigned char>(head_[1]) == 0x8b;
+                if (!start(gzip)) {
+                    return false;
+                }
+                if (!consume(head_, head_len_)) {
+                    return false;
+                }
+            }
+            return consume(data, n);
+        }
+
+        // Flushes a document shorter than the detection window; false on a truncated gzip stream
+        bool finish() {
+            if (!failed_ && mode_ == Mode::Unknown && head_len_ > 0) {
+                start(false);
+                consume(head_, head_len_);
+            }
+#ifdef SITEMAP_GZIP
+            if (!failed_ && mode_ == Mode::Gzip && !gzip_done_) {
+                error_ = "truncated gzip stream";
+                failed_ = true;
+            }
+#endif
+            return !failed_;
+        }
+
+        bool failed() const {
+            return failed_;
+        }
+
+        const std::string& error() const {
+            return error_;
+        }
+
+        bool isIndex() const {
+            return parser_.isIndex();
+        }
+
+        uint64_t bytesIn() const {
+            return bytes_in_;
+        }
+
+        uint64_t bytesXml() const {
+            return bytes_xml_;
+        }
+
+    private:
+
+        enum class Mode {Unknown, Plain, Gzip};
+
+        bool start(bool gzip) {
+            if (!gzip) {
+                mode_ = Mode::Plain;
+                return true;
+            }
+#ifdef SITEMAP_GZIP
+            std::memset(&zs_, 0, sizeof(zs_));
+            // 16 + MAX_WBITS: gzip wrapper only
+            if (inflateInit2(&zs_, 16 + MAX_WBITS) != Z_OK) {
+                error_ = "inflateInit2 failed";
+                failed_ = true;
+                return false;
+            }
+            inflating_ = true;
+            mode_ = Mode::Gzip;
+            return true;
+#else
+            error_ = "gzip sitemap but built without zlib";
+            failed_ = true;
+            return false;
+#endif
+        }
+
+        bool consume(const char* data, size_t n) {
+
+            bytes_in_ += n;
+
+            if (mode_ == Mode::Plain) {
+                bytes_xml_ += n;
+                parser_.feed(data, n);
+                return true;
+            }
+
+#ifdef SITEMAP_GZIP
+            zs_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+            zs_.avail_in = static_cast<uInt>(n);
+
+            while (zs_.avail_in > 0 && !gzip_done_) {
+                zs_.next_out = reinterpret_cast<Bytef*>(window_);
+                zs_.avail_out = sizeof(window_);
+                int rc = inflate(&zs_, Z_NO_FLUSH);
+                if (rc != Z_OK && rc != Z_STREAM_END) {
+                    error_ = zs_.msg ? zs_.msg : "inflate failed";
+                    failed_ = true;
+                    return false;
+                }
+                const size_t produced = sizeof(window_) - zs_.avail_out;
+                bytes_xml_ += produced;
+                parser_.feed(window_, produced);
+                if (rc == Z_STREAM_END) {
+                    gzip_done_ = true;
+                }
+            }
+#endif
+            return true;
+        }
+
+        SitemapParser parser_;
+        Mode mode_ = Mode::Unknown;
+        char head_[2];
+        size_t head_len_ = 0;
+        bool failed_ = false;
+        std::string error_;
+        uint64_t bytes_in_ = 0;
+        uint64_t bytes_xml_ = 0;
+
+#ifdef SITEMAP_GZIP
+        z_stream zs_;
+        bool inflating_ = false;
+        bool gzip_done_ = false;
+        char window_[64 * 1024];
+#endif
+
+};
+
+
+// Fetches a sitemap (http(s), file:// or a plain local path), follows sitemap indexes
+// breadth first and hands <url> entries over in fixed-size batches.
+class SitemapLoader {
+
+    public:
+
+        // The handler may move entries out of the batch; it is cleared afterwards
+        using BatchHandler = std::function<void(std::vector<SitemapEntry>& batch)>;
+
+        explicit SitemapLoader(const std::string& user_agent = "Downloader/1.0", const std::string& ca_path = "")
+            : user_agent_(user_agent), ca_path_(ca_path) {}
+
+        void setBatchSize(size_t n) {
+            batch_size_ = n == 0 ? 1 : n;
+        }
+
+        // Cap on sitemap files fetched per load(), indexes included
+        void setMaxSitemaps(size_t n) {
+            max_sitemaps_ = n;
+        }
+
+        // The protocol allows one level of indexes; a little slack for sites that nest anyway
+        void setMaxDepth(int depth) {
+            max_depth_ = depth < 0 ? 0 : depth;
+        }
+
+        void setTimeoutMs(long ms) {
+            timeout_ms_ = ms;
+        }
+
+        SitemapStats load(const std::string& location, const BatchHandler& handler) {
+
+            const auto start = std::chrono::steady_clock::now();
+            SitemapStats stats;
+
+            std::vector<SitemapEntry> batch;
+            batch.reserve(batch_size_);
+            auto flush = [&]() {
+                if (!batch.empty()) {
+                    ++stats.batches;
+                    handler(batch);
+                    batch.clear();
+                }
+            };
+
+            std::deque<std::pair<std::string, int>> pending;
+            std::unordered_set<uint64_t> visited;
+            pending.emplace_back(location, 0);
+            visited.insert(UrlUtils::fingerprint(location));
+
+            size_t fetched = 0;
+            while (!pending.empty() && fetched < max_sitemaps_) {
+
+                const std::string current = std::move(pending.front().first);
+                const int depth = pending.front().second;
+                pending.pop_front();
+                ++fetched;
+
+                SitemapStream stream([&](SitemapEntry&& entry, SitemapUtils::EntryType type) {
+                    if (type == SitemapUtils::EntryType::Sitemap) {
+                        if (depth < max_depth_ && visited.insert(UrlUtils::fingerprint(entry.loc)).second) {
+                            pending.emplace_back(std::move(entry.loc), depth + 1);
+                        }
+                        return;
+                    }
+                    ++stats.urls;
+                    batch.push_back(std::move(entry));
+                    if (batch.size() >= batch_size_) {
+                        flush();
+                    }
+                });
+
+                const bool ok = current.find("://") == std::string::npos ? readFile(current, stream) : fetch(current, stream);
+                stats.bytes_read += stream.bytesIn();
+                stats.bytes_xml += stream.bytesXml();
+                if (ok) {
+                    ++stats.sitemaps_loaded;
+                    if (stream.isIndex()) {
+                        ++stats.indexes;
+                    }
+                }
+                else {
+                    ++stats.sitemaps_failed;
+                    //use logger?
+                }
+            }
+
+            flush();
+            stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            return stats;
+        }
+
+    private:
+
+        static size_t writeCallback(void* contents, size_t size, size_t nmemb, void* userp) {
+            const size_t total = size * nmemb;
+            SitemapStream* stream = static_cast<SitemapStream*>(userp);
+            // anything other than total makes curl abort the transfer
+            return stream->write(static_cast<const char*>(contents), total) ? total : 0;
+        }
+
+        bool fetch(const std::string& url, SitemapStream& stream) {
+
+            CURL* curl = curl_easy_init();
+            if (!curl) {
+                return false;
+            }
+            curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeCallback);
+            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &stream);
+            curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+            curl_easy_setopt(curl, CURLOPT_USERAGENT, user_agent_.c_str());
+            curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, timeout_ms_);
+            curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+            // transport compression is undone by curl, a .gz body is left to the stream
+            curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");
+            if (!ca_path_.empty()) {
+                curl_easy_setopt(curl, CURLOPT_CAINFO, ca_path_.c_str());
+            }
+
+            CURLcode res = curl_easy_perform(curl);
+            curl_easy_cleanup(curl);
+
+            return res == CURLE_OK && stream.finish();
+        }
+
+        bool readFile(const std::string& path, SitemapStream& stream) {
+
+            std::ifstream in(path, std::ios::binary);
+            if (!in) {
+                return false;
+            }
+            std::vector<char> chunk(64 * 1024);
+            while (in) {
+                in.read(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+                const std::streamsize got = in.gcount();
+                if (got > 0 && !stream.write(chunk.data(), static_cast<size_t>(got))) {
+                    return false;
+                }
+            }
+            return stream.finish();
+        }
+
+        std::string user_agent_;
+        std::string ca_path_;
+        size_t batch_size_ = 4096;
+        size_t max_sitemaps_ = 1000;
+        int max_depth_ = 2;
+        long timeout_ms_ = 60000;
+
+};
+
+#endif
\ No newline at end of file
@@ -37,6 +37,7 @@ class ThreadPool {
             }
         }
 
+        // Returns false once stopped; a refused task is left untouched
         template<typename F>
         bool enqueue(F&& task) {
             {
@@ -54,6 +55,12 @@ class ThreadPool {
         }
 
 
+        // True once stop() has begun; enqueue() refuses every task from then on
+        bool stopped() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return shutdown_;
+        }
+
         void stop() {
 
             if (shutdown_) {
@@ -0,0 +1,332 @@
+#ifndef TRACER_HPP
+#define TRACER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+
+namespace TracerUtils {
+
+    enum class Mode {
+        OFF = 0,
+        SAMPLED,
+        COMPLETE
+    };
+
+    inline void writeJsonString(std::ostream& out, const std::string& s) {
+        static const char* hex = "0123456789abcdef";
+        out << '"';
+        for (unsigned char c : s) {
+            switch (c) {
+                case '"':  out << "\\\""; break;
+                case '\\': out << "\\\\"; break;
+                case '\n': out << "\\n";  break;
+                case '\r': out << "\\r";  break;
+                case '\t': out << "\\t";  break;
+                default:
+                    if (c < 0x20) {
+                        out << "\\u00" << hex[c >> 4] << hex[c & 0xf];
+                    }
+                    else {
+                        out << static_cast<char>(c);
+                    }
+            }
+        }
+        out << '"';
+    }
+
+}
+
+
+// One fetch, from the moment it was handed to the pool until its page hit the disk.
+// Curl phase times are the cumulative CURLINFO_*_TIME_T values in microseconds.
+struct FetchTrace {
+    std::string url;
+    std::thread::id threadId;                       // ran the transfer
+    std::thread::id saveThreadId;                   // ran savePage; unset means threadId
+    std::chrono::steady_clock::time_point enqueued;
+    std::chrono::steady_clock::time_point started;
+    std::chrono::steady_clock::time_point transferred;
+    std::chrono::steady_clock::time_point saving;   // save task began; unset means right after transferred
+    std::chrono::steady_clock::time_point stored;
+    int64_t namelookup_us = 0;
+    int64_t connect_us = 0;
+    int64_t appconnect_us = 0;
+    int64_t pretransfer_us = 0;
+    int64_t starttransfer_us = 0;
+    int64_t total_us = 0;
+    int64_t redirect_us = 0;
+    long status = 0;
+    int result = 0;
+};
+
+
+class Tracer {
+
+    public:
+
+        static Tracer& instance() {
+            static Tracer tracer;
+            return tracer;
+        }
+
+        Tracer(const Tracer&) = delete;
+        Tracer& operator=(const Tracer&) = delete;
+
+        // sample_every is only used in SAMPLED mode: one fetch out of every N is kept
+        void setMode(TracerUtils::Mode mode, uint32_t sample_every = 100) {
+            sample_every_.store(sample_every == 0 ? 1 : sample_every, std::memory_order_relaxed);
+            mode_.store(mode, std::memory_order_relaxed);
+        }
+
+        TracerUtils::Mode getMode() const {
+            return mode_.load(std::memory_order_relaxed);
+        }
+
+        void setCapacity(size_t capacity) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            capacity_ = capacity == 0 ? 1 : capacity;
+            buffer_.clear();
+            buffer_.reserve(capacity_);
+            head_ = 0;
+        }
+
+        // Cheap enough to call on every fetch; decides whether this one gets traced
+        bool shouldTrace() {
+            switch (mode_.load(std::memory_order_relaxed)) {
+                case TracerUtils::Mode::COMPLETE:
+                    return true;
+                case TracerUtils::Mode::SAMPLED:
+                    return seq_.fetch_add(1, std::memory_order_relaxed)
+                           % sample_every_.load(std::memory_order_relaxed) == 0;
+                default:
+                    return false;
+            }
+        }
+
+        void record(FetchTrace&& trace) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (buffer_.size() < capacity_) {
+                buffer_.push_back(std::move(trace));
+                return;
+            }
+            // ring buffer: overwrite the oldest entry
+            buffer_[head_] = std::move(trace);
+            head_ = (head_ + 1) % capacity_;
+            ++overwritten_;
+        }
+
+        size_t size() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return buffer_.size();
+        }
+
+        uint64_t overwritten() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return overwritten_;
+        }
+
+        void clear() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            buffer_.clear();
+            head_ = 0;
+            overwritten_ = 0;
+        }
+
+        // Chrome trace event format, loadable in chrome://tracing and ui.perfetto.dev
+        void writeChromeTrace(std::ostream& out) {
+
+            std::vector<FetchTrace> traces;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                traces.reserve(buffer_.size());
+                for (size_t i = 0; i < buffer_.size(); ++i) {
+                    traces.push_back(buffer_[(head_ + i) % buffer_.size()]);
+                }
+            }
+
+            std::unordered_map<std::thread::id, int> threads;
+            for (const auto& t : traces) {
+                threads.emplace(t.threadId, static_cast<int>(threads.size()) + 1);
+            }
+            for (const auto& t : traces) {
+                if (t.saveThreadId != std::thread::id()) {
+                    threads.emplace(t.saveThreadId, static_cast<int>(threads.size()) + 1);
+                }
+            }
+
+            // A viewer stacks the slices of one tid by nesting, so slices that overlap without
+            // nesting (transfers multiplexed by one thread) go to extra lanes of that thread
+            struct Span {
+                int thread;
+                int64_t begin;
+                int64_t end;
+                size_t slot;         // fetch of trace i at 2i, its save_page at 2i + 1
+            };
+            std::vector<Span> spans;
+            spans.reserve(traces.size() * 2);
+            for (size_t i = 0; i < traces.size(); ++i) {
+                const FetchTrace& t = traces[i];
+                spans.push_back(Span{threads[t.threadId], toMicros(t.started), toMicros(t.transferred), 2 * i});
+                // handle cleanup and the wait for a worker are not part of saving
+                const auto saving = t.saving > t.transferred ? t.saving : t.transferred;
+                if (t.stored > saving) {
+                    const std::thread::id saver = t.saveThreadId == std::thread::id() ? t.threadId : t.saveThreadId;
+                    spans.push_back(Span{threads[saver], toMicros(saving), toMicros(t.stored), 2 * i + 1});
+                }
+            }
+            std::sort(spans.begin(), spans.end(), [](const Span& a, const Span& b) {
+                return a.thread != b.thread ? a.thread < b.thread : a.begin < b.begin;
+            });
+
+            std::map<std::pair<int, size_t>, int> lanes;        // (thread, lane) -> tid
+            std::vector<int> tids(traces.size() * 2, 0);
+            std::vector<int64_t> lane_end;
+            for (size_t k = 0; k < spans.size(); ++k) {
+                if (k == 0 || spans[k].thread != spans[k - 1].thread) {
+                    lane_end.clear();
+                }
+                size_t lane = 0;
+                while (lane < lane_end.size() && lane_end[lane] > spans[k].begin) {
+                    ++lane;
+                }
+                if (lane == lane_end.size()) {
+                    lane_end.push_back(0);
+                }
+                lane_end[lane] = spans[k].end;
+                auto it = lanes.emplace(std::make_pair(spans[k].thread, lane), static_cast<int>(lanes.size()) + 1).first;
+                tids[spans[k].slot] = it->second;
+            }
+
+            out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+            bool first = true;
+            auto sep = [&]() {
+                if (!first) {
+                    out << ',';
+                }
+                first = false;
+                out << '\n';
+            };
+
+            for (const auto& kv : lanes) {
+                sep();
+                out << "{\"ph\":\"M\",\"pid\":1,\"tid\":" << kv.second
+                    << ",\"name\":\"thread_name\",\"args\":{\"name\":\"worker " << kv.first.first;
+                if (kv.first.second > 0) {
+                    out << " lane " << kv.first.second;
+                }
+                out << "\"}}";
+            }
+
+            uint64_t id = 0;
+            for (size_t i = 0; i < traces.size(); ++i) {
+
+                const FetchTrace& t = traces[i];
+                const int tid = tids[2 * i];
+                const int64_t start = toMicros(t.started);
+                const int64_t end = toMicros(t.transferred);
+
+                // queue waits overlap each other, so they go out as async events
+                sep();
+                out << "{\"ph\":\"b\",\"cat\":\"queue\",\"name\":\"queue_wait\",\"pid\":1,\"tid\":" << tid
+                    << ",\"id\":" << id << ",\"ts\":" << toMicros(t.enqueued) << '}';
+                sep();
+                out << "{\"ph\":\"e\",\"cat\":\"queue\",\"name\":\"queue_wait\",\"pid\":1,\"tid\":" << tid
+                    << ",\"id\":" << id << ",\"ts\":" << start << '}';
+
+                sep();
+                out << "{\"ph\":\"X\",\"cat\":\"fetch\",\"name\":\"fetch\",\"pid\":1,\"tid\":" << tid
+                    << ",\"ts\":" << start << ",\"dur\":" << (end - start) << ",\"args\":{\"url\":";
+                TracerUtils::writeJsonString(out, t.url);
+                out << ",\"status\":" << t.status << ",\"curl_result\":" << t.result << "}}";
+
+                const int64_t secure = t.appconnect_us > 0 ? t.appconnect_us : t.connect_us;
+                int64_t at = start;
+                // curl's clock starts a little after ours, so phases are clipped to the fetch
+                auto phase = [&](const char* name, int64_t from_us, int64_t to_us) {
+                    const int64_t from = at + from_us;
+                    const int64_t to = std::min(at + to_us, end);
+                    if (to <= from) {
+                        return;
+                    }
+                    sep();
+                    out << "{\"ph\":\"X\",\"cat\":\"fetch\",\"name\":\"" << name << "\",\"pid\":1,\"tid\":" << tid
+                        << ",\"ts\":" << from << ",\"dur\":" << (to - from) << '}';
+                };
+
+                phase("redirect", 0, t.redirect_us);
+                at += t.redirect_us;
+                phase("dns", 0, t.namelookup_us);
+                phase("tcp_connect", t.namelookup_us, t.connect_us);
+                phase("tls", t.connect_us, t.appconnect_us);
+                phase("request", secure, t.pretransfer_us);
+                phase("ttfb", t.pretransfer_us, t.starttransfer_us);
+                // total covers the redirect steps too, the phases above only the final request
+                phase("transfer", t.starttransfer_us, t.total_us - t.redirect_us);
+
+                // save_page runs as its own task, usually on another thread: a flow arrow ties
+                // it to the fetch it belongs to
+                const auto saving = t.saving > t.transferred ? t.saving : t.transferred;
+                if (t.stored > saving) {
+                    const int save_tid = tids[2 * i + 1];
+                    const int64_t from = toMicros(saving);
+                    sep();
+                    out << "{\"ph\":\"X\",\"cat\":\"fetch\",\"name\":\"save_page\",\"pid\":1,\"tid\":" << save_tid
+                        << ",\"ts\":" << from << ",\"dur\":" << (toMicros(t.stored) - from) << '}';
+                    sep();
+                    out << "{\"ph\":\"s\",\"cat\":\"save\",\"name\":\"save\",\"pid\":1,\"tid\":" << tid
+                        << ",\"id\":" << id << ",\"ts\":" << std::max(start, end - 1) << '}';
+                    sep();
+                    out << "{\"ph\":\"f\",\"bp\":\"e\",\"cat\":\"save\",\"name\":\"save\",\"pid\":1,\"tid\":" << save_tid
+                        << ",\"id\":" << id << ",\"ts\":" << from << '}';
+                }
+                ++id;
+            }
+
+            out << "\n]}\n";
+        }
+
+        bool exportChromeTrace(const std::string& path) {
+            std::ofstream ofs(path, std::ios::binary);
+            if (!ofs) {
+                return false;
+            }
+            writeChromeTrace(ofs);
+            return static_cast<bool>(ofs);
+        }
+
+    private:
+
+        Tracer() : epoch_(std::chrono::steady_clock::now()) {
+            buffer_.reserve(capacity_);
+        }
+
+        int64_t toMicros(std::chrono::steady_clock::time_point tp) const {
+            return std::chrono::duration_cast<std::chrono::microseconds>(tp - epoch_).count();
+        }
+
+        const std::chrono::steady_clock::time_point epoch_;
+        std::atomic<TracerUtils::Mode> mode_{TracerUtils::Mode::OFF};
+        std::atomic<uint32_t> sample_every_{100};
+        std::atomic<uint64_t> seq_{0};
+
+        std::mutex mutex_;
+        std::vector<FetchTrace> buffer_;
+        size_t capacity_ = 65536;
+        size_t head_ = 0;
+        uint64_t overwritten_ = 0;
+
+};
+
+#endif
@@ -0,0 +1,216 @@
+#ifndef URL_HPP
+#define URL_HPP
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace UrlUtils {
+
+    // FNV-1a, used as the URL fingerprint for dedup and the link graph
+    inline uint64_t fingerprint(std::string_view s) {
+        uint64_t h = 1469598103934665603ull;
+        for (unsigned char c : s) {
+            h ^= c;
+            h *= 1099511628211ull;
+        }
+        return h;
+    }
+
+    inline bool isHttp(std::string_view url) {
+        auto startsWith = [&](std::string_view p) {
+            if (url.size() < p.size()) {
+                return false;
+            }
+            for (size_t i = 0; i < p.size(); ++i) {
+                char c = url[i];
+                if (c >= 'A' && c <= 'Z') c = static_cast<char>(c + 32);
+                if (c != p[i]) {
+                    return false;
+                }
+            }
+            return true;
+        };
+        return startsWith("http://") || startsWith("https://");
+    }
+
+    // "scheme://authority" part, without the trailing slash
+    inline std::string_view origin(std::string_view url) {
+        size_t p = url.find("://");
+        if (p == std::string_view::npos) {
+            return {};
+        }
+        size_t end = url.find_first_of("/?#", p + 3);
+        return url.substr(0, end == std::string_view::npos ? url.size() : end);
+    }
+
+    // host[:port], lower-cased, without userinfo
+    inline std::string host(std::string_view url) {
+        size_t p = url.find("://");
+        if (p == std::string_view::npos) {
+            return {};
+        }
+        std::string_view auth = origin(url).substr(p + 3);
+        size_t at = auth.rfind('@');
+        if (at != std::string_view::npos) {
+            auth = auth.substr(at + 1);
+        }
+        std::string out;
+        out.reserve(auth.size());
+        for (char c : auth) {
+            out.push_back((c >= 'A' && c <= 'Z') ? static_cast<char>(c + 32) : c);
+        }
+        return out;
+    }
+
+    // host without the port
+    inline std::string hostname(std::string_view url) {
+        std::string h = host(url);
+        if (!h.empty() && h.front() == '[') {
+            size_t close = h.find(']');
+            return close == std::string::npos ? h : h.substr(1, close - 1);
+        }
+        size_t colon = h.rfind(':');
+        return colon == std::string::npos ? h : h.substr(0, colon);
+    }
+
+    // explicit port, or the scheme default
+    inline int port(std::string_view url) {
+        std::string h = host(url);
+        size_t colon = h.rfind(':');
+        size_t close = h.rfind(']');
+        if (colon != std::string::npos && (close == std::string::npos || colon > close)) {
+            return std::atoi(h.c_str() + colon + 1);
+        }
+        return (url.size() >= 5 && (url[4] == 's' || url[4] == 'S')) ? 443 : 80;
+    }
+
+    inline std::string stripFragment(std::string_view url) {
+        size_t p = url.find('#');
+        return std::string(url.substr(0, p));
+    }
+
+    // Collapses "." and ".." segments of an absolute path
+    inline std::string removeDotSegments(std::string_view path) {
+        std::vector<std::string_view> segments;
+        bool trailing_slash = false;
+        size_t i = (!path.empty() && path.front() == '/') ? 1 : 0;
+        while (i <= path.size()) {
+            size_t j = path.find('/', i);
+            if (j == std::string_view::npos) {
+                j = path.size();
+            }
+            std::string_view seg = path.substr(i, j - i);
+            const bool last = j == path.size();
+            if (seg == ".") {
+                trailing_slash = last;
+            }
+            else if (seg == "..") {
+                if (!segments.empty()) {
+                    segments.pop_back();
+                }
+                trailing_slash = last;
+            }
+            else if (!last || !seg.empty()) {
+                segments.push_back(seg);
+                trailing_slash = false;
+            }
+            else {
+                trailing_slash = true;
+            }
+            i = j + 1;
+        }
+        std::string out;
+        out.reserve(path.size() + 1);
+        for (auto seg : segments) {
+            out.push_back('/');
+            out.append(seg.data(), seg.size());
+        }
+        if (trailing_slash || out.empty()) {
+            out.push_back('/');
+        }
+        return out;
+    }
+
+    // Resolves href against the absolute base URL (RFC 3986, minus the rarely seen corners).
+    // Returns an empty string for non-http(s) targets such as mailto: or javascript:
+    inline std::string resolve(std::string_view base, std::string_view href) {
+
+        while (!href.empty() && (href.front() == ' ' || href.front() == '\t' || href.front() == '\n' || href.front() == '\r')) {
+            href.remove_prefix(1);
+        }
+        while (!href.empty() && (href.back() == ' ' || href.back() == '\t' || href.back() == '\n' || href.back() == '\r')) {
+            href.remove_suffix(1);
+        }
+
+        if (href.empty() || href.front() == '#') {
+            return stripFragment(base);
+        }
+
+        size_t colon = href.find(':');
+        size_t first_delim = href.find_first_of("/?#");
+        if (colon != std::string_view::npos && (first_delim == std::string_view::npos || colon < first_delim)) {
+            if (!isHttp(href)) {
+                return {};
+            }
+            std::string_view o = origin(href);
+            std::string_view rest = href.substr(o.size());
+            size_t q = rest.find_first_of("?#");
+            std::string path(rest.substr(0, q == std::string_view::npos ? rest.size() : q));
+            std::string out(o);
+            out += removeDotSegments(path.empty() ? "/" : path);
+            if (q != std::string_view::npos) {
+                out.append(rest.substr(q));
+            }
+            return stripFragment(out);
+        }
+
+        std::string_view base_origin = origin(base);
+        if (base_origin.empty()) {
+            return {};
+        }
+
+        if (href.size() >= 2 && href[0] == '/' && href[1] == '/') {
+            size_t p = base.find("://");
+            std::string out(base.substr(0, p + 1));
+            out.append(href);
+            return resolve(base, out);
+        }
+
+        std::string_view base_rest = base.substr(base_origin.size());
+        size_t bq = base_rest.find_first_of("?#");
+        std::string_view base_path = base_rest.substr(0, bq == std::string_view::npos ? base_rest.size() : bq);
+        if (base_path.empty()) {
+            base_path = "/";
+        }
+
+        std::string out(base_origin);
+        if (href.front() == '?') {
+            out.append(base_path);
+            out.append(href);
+            return stripFragment(out);
+        }
+
+        size_t hq = href.find_first_of("?#");
+        std::string_view href_path = href.substr(0, hq == std::string_view::npos ? href.size() : hq);
+        std::string path;
+        if (href.front() == '/') {
+            path.assign(href_path);
+        }
+        else {
+            path.assign(base_path.substr(0, base_path.rfind('/') + 1));
+            path.append(href_path);
+        }
+        out += removeDotSegments(path);
+        if (hq != std::string_view::npos) {
+            out.append(href.substr(hq));
+        }
+        return stripFragment(out);
+    }
+
+}
+
+#endif
@@ -0,0 +1,110 @@
+#include "inverted_index.hpp"
+#include "thread_pool.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <thread>
+
+// index_query <index dir> [--limit N] <term> [term...]   documents containing every term
+// index_query <index dir> --build <download dir>         index the pages a crawl saved
+// index_query <index dir> --stats
+static int usage() {
+    std::cerr << "usage: index_query <index dir> [--limit N] <term> [term...]\n"
+              << "       index_query <index dir> --build <download dir> [--threads N]\n"
+              << "       index_query <index dir> --stats\n";
+    return 2;
+}
+
+static void printStats(const IndexStats& s) {
+    std::cout << s.total_docs << " docs, " << s.segments << " segment(s), "
+              << s.disk_bytes / 1024 << " KiB on disk, " << s.flushes << " flushes, " << s.merges << " merges\n";
+}
+
+int main(int argc, char** argv) {
+
+    if (argc < 3) {
+        return usage();
+    }
+
+    const std::string dir = argv[1];
+    std::string build_dir;
+    std::string query;
+    size_t limit = 10;
+    int threads = static_cast<int>(std::thread::hardware_concurrency());
+    bool stats_only = false;
+
+    for (int i = 2; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--build" && i + 1 < argc) {
+            build_dir = argv[++i];
+        }
+        else if (arg == "--limit" && i + 1 < argc) {
+            limit = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--threads" && i + 1 < argc) {
+            threads = std::atoi(argv[++i]);
+        }
+        else if (arg == "--stats") {
+            stats_only = true;
+        }
+        else {
+            query += query.empty() ? arg : " " + arg;
+        }
+    }
+
+    InvertedIndex index(dir);
+
+    if (!build_dir.empty()) {
+        // saved file names stand in for URLs, the mapping back is not reversible
+        const auto start = std::chrono::steady_clock::now();
+        {
+            ThreadPool pool;
+            pool.start(threads < 1 ? 1 : threads);
+            std::error_code ec;
+            for (auto it = std::filesystem::recursive_directory_iterator(build_dir, ec);
+                 !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+                if (!it->is_regular_file()) {
+                    continue;
+                }
+                pool.enqueue([&index, path = it->path()]() {
+                    std::ifstream in(path, std::ios::binary);
+                    std::string html((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+                    index.addDocument(path.string(), html);
+                });
+            }
+            pool.stop();
+        }
+        index.flush();
+        const double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        const IndexStats s = index.stats();
+        printStats(s);
+        std::cout << "indexed " << s.text_bytes / (1024 * 1024) << " MiB in " << wall << " s: "
+                  << (wall > 0.0 ? s.docs / wall : 0.0) << " docs/sec wall, "
+                  << s.docsPerSec() << " docs/sec per indexing thread\n";
+        return 0;
+    }
+
+    if (stats_only) {
+        printStats(index.stats());
+        return 0;
+    }
+
+    if (query.empty()) {
+        return usage();
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    const std::vector<IndexHit> hits = index.search(query, limit);
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    for (const auto& hit : hits) {
+        std::cout << hit.score << '\t' << hit.url << '\n';
+    }
+    std::cout << hits.size() << " hit(s) in " << ms << " ms\n";
+    return 0;
+}
@@ -1,10 +1,14 @@
 #include "thread_pool.hpp"
 #include "logger.hpp"
 #include "downloader.hpp"
+#include "tracer.hpp"
+#include "crawler.hpp"
+#include "sitemap.hpp"
+#include "inverted_index.hpp"
 #include <chrono>
 #include <string>
 
-int main() {
+int main(int argc, char** argv) {
 
     auto& logger = Logger::instance();
 
@@ -16,19 +20,61 @@ int main() {
 
     LOG_INFO("Downloader test started");
 
+    Tracer::instance().setMode(TracerUtils::Mode::COMPLETE);
+
     ThreadPool pool;
     pool.start(4);
 
     Downloader& downloader = Downloader::instance(pool, "Downloads", "Adam/0.1"); //full path or just folder
 
-    downloader.enqueue("https://www.britannica.com");
-    downloader.enqueue("https://www.britannica.com/money/u3-unemployment-vs-u6-underemployment");
-    downloader.enqueue("https://www.britannica.com/event/2025-NBA-Betting-and-Gambling-Scandal");
-    downloader.enqueue("https://www.britannica.com/topic/National-Basketball-Association");
+    if (argc > 1) {
+        // main_exe <sitemap url or file> [max pages]: seed the crawl frontier from a sitemap
+        Crawler& crawler = Crawler::instance(downloader);
+        crawler.setMaxPages(argc > 2 ? std::stoul(argv[2]) : 100);
+
+        SitemapLoader sitemaps(downloader.userAgent(), downloader.caPath());
+        SitemapStats s = sitemaps.load(argv[1], [&crawler](std::vector<SitemapEntry>& batch) {
+            crawler.seedBatch(batch);
+        });
+        LOG_INFO("Seeded ", s.urls, " URLs from ", s.sitemaps_loaded, " sitemap(s) in ", s.seconds, " s (",
+                 s.sitemaps_failed, " failed)");
+
+        // searchable afterwards with index_query Index <terms>
+        InvertedIndex index("Index");
+        crawler.setIndex(&index);
+
+        crawler.run();
+
+        pool.stop(); // indexing tasks finish before the index closes
+        crawler.setIndex(nullptr);
+        index.close();
+        IndexStats is = index.stats();
+        LOG_INFO("Indexed ", is.docs, " pages at ", is.docsPerSec(), " docs/sec into ", is.segments, " segment(s)");
+        for (const auto& name : index.unreadableSegments()) {
+            LOG_ERROR("Index segment ", name, " could not be opened; it is kept in the manifest");
+        }
+        if (is.failed_flushes > 0) {
+            LOG_ERROR(is.failed_flushes, " index segment(s) could not be written");
+        }
+    }
+    else {
+        downloader.enqueue("https://www.britannica.com");
+        downloader.enqueue("https://www.britannica.com/money/u3-unemployment-vs-u6-underemployment");
+        downloader.enqueue("https://www.britannica.com/event/2025-NBA-Betting-and-Gambling-Scandal");
+        downloader.enqueue("https://www.britannica.com/topic/National-Basketball-Association");
+    }
 
     pool.stop();
 
     LOG_INFO("All downloads completed");
+
+    DnsStats dns = downloader.dns().stats();
+    LOG_INFO("DNS: ", dns.lookups, " lookups, hit rate ", dns.hitRate(), ", ", dns.resolutions, " resolutions (",
+             dns.failures, " failed) at ", dns.meanResolveMs(), " ms mean");
+
+    if (Tracer::instance().exportChromeTrace("fetch_trace.json")) {
+        LOG_INFO("Fetch trace written to fetch_trace.json (", Tracer::instance().size(), " fetches)");
+    }
     LOG_INFO("Downloader test finished");
 
     return 0;
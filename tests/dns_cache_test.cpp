@@ -0,0 +1,174 @@
+#include "dns_cache.hpp"
+#include "logger.hpp"
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Stands in for a DNS server: fixed answers, a fixed delay, and a count of queries per name
+class StubResolver {
+
+    public:
+
+        explicit StubResolver(int delay_ms) : delay_ms_(delay_ms) {}
+
+        void set(const std::string& host, std::vector<std::string> addresses, int ttl) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            zone_[host] = DnsAnswer{std::move(addresses), ttl};
+        }
+
+        int queries(const std::string& host) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return queries_[host];
+        }
+
+        DnsAnswer operator()(const std::string& host) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms_));
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++queries_[host];
+            auto it = zone_.find(host);
+            return it == zone_.end() ? DnsAnswer{} : it->second;
+        }
+
+    private:
+
+        int delay_ms_;
+        std::mutex mutex_;
+        std::map<std::string, DnsAnswer> zone_;
+        std::map<std::string, int> queries_;
+
+};
+
+int main() {
+    auto& logger = Logger::instance();
+    logger.setLevel(LoggerUtils::Level::INFO);
+
+    auto consoleSink = std::make_shared<ConsoleSink>();
+    logger.addSink(consoleSink);
+
+    LOG_INFO("DnsCache test started");
+
+    bool ok = true;
+    using Clock = std::chrono::steady_clock;
+    auto ms = [](Clock::time_point since) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+    };
+
+    ok = ok && DnsUtils::isIpLiteral("127.0.0.1") && DnsUtils::isIpLiteral("::1") && DnsUtils::isIpLiteral("[::1]");
+    ok = ok && !DnsUtils::isIpLiteral("example.com") && !DnsUtils::isIpLiteral("1.example") &&
+         !DnsUtils::isIpLiteral("");
+
+    auto stub = std::make_shared<StubResolver>(50);
+    for (int i = 0; i < 20; ++i) {
+        stub->set("h" + std::to_string(i) + ".test", {"10.0.0." + std::to_string(i)}, 300);
+    }
+    stub->set("short.test", {"10.1.0.1", "fd00::1"}, 1);
+
+    DnsCache cache;
+    cache.setResolver([stub](const std::string& host) { return (*stub)(host); });
+    cache.setThreads(4);
+    cache.setTtl(300, 0, 3600);
+    cache.setNegativeTtl(1);
+
+    // prefetched names are answered without waiting for the resolver
+    {
+        for (int i = 0; i < 20; ++i) {
+            ok = ok && cache.prefetch("h" + std::to_string(i) + ".test");
+        }
+        ok = ok && !cache.prefetch("h0.test"); // already in flight
+        std::this_thread::sleep_for(std::chrono::milliseconds(20 * 50 + 200));
+
+        const auto start = Clock::now();
+        std::vector<std::string> addresses;
+        for (int i = 0; i < 20; ++i) {
+            ok = ok && cache.resolve("h" + std::to_string(i) + ".test", addresses) &&
+                 addresses == std::vector<std::string>{"10.0.0." + std::to_string(i)};
+        }
+        const double elapsed = ms(start);
+        LOG_INFO("20 prefetched lookups took ", elapsed, " ms");
+        ok = ok && elapsed < 25.0 && stub->queries("h7.test") == 1 && !cache.prefetch("h7.test");
+        if (!ok) {
+            LOG_ERROR("prefetch mismatch");
+            return 1;
+        }
+    }
+
+    // concurrent first lookups of one name share a single query
+    {
+        std::atomic<int> resolved{0};
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 8; ++i) {
+            threads.emplace_back([&]() {
+                std::vector<std::string> addresses;
+                if (cache.resolve("short.test", addresses) && addresses.size() == 2) {
+                    resolved.fetch_add(1);
+                }
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        ok = ok && resolved.load() == 8 && stub->queries("short.test") == 1;
+        if (!ok) {
+            LOG_ERROR("concurrent lookups were not coalesced");
+            return 1;
+        }
+    }
+
+    // the answer's TTL is honoured, and a failing name is cached negatively
+    {
+        std::vector<std::string> addresses;
+        ok = ok && !cache.resolve("nx.test", addresses) && addresses.empty();
+        const auto start = Clock::now();
+        ok = ok && !cache.resolve("nx.test", addresses);
+        ok = ok && ms(start) < 25.0 && stub->queries("nx.test") == 1;
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+        ok = ok && cache.resolve("short.test", addresses) && stub->queries("short.test") == 2;
+        ok = ok && !cache.resolve("nx.test", addresses) && stub->queries("nx.test") == 2;
+
+        // a name that starts resolving replaces its negative entry
+        stub->set("nx.test", {"10.2.0.1"}, 300);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+        ok = ok && cache.prefetch("nx.test");
+        ok = ok && cache.resolve("nx.test", addresses) && addresses == std::vector<std::string>{"10.2.0.1"};
+        if (!ok) {
+            LOG_ERROR("TTL handling mismatch");
+            return 1;
+        }
+    }
+
+    DnsStats s = cache.stats();
+    LOG_INFO(s.lookups, " lookups, ", s.hits, " hits, ", s.negative_hits, " negative hits, ", s.joined, " joined, ",
+             s.misses, " misses (", s.expired, " expired), ", s.prefetches, " prefetches, hit rate ", s.hitRate(),
+             ", mean resolve ", s.meanResolveMs(), " ms");
+    ok = ok && s.hits == 20 && s.negative_hits == 1 && s.expired == 2 && s.prefetches == 21 &&
+         s.failures == 2 && s.joined >= 1 && s.lookups == s.hits + s.negative_hits + s.joined + s.misses;
+
+    // a bounded cache drops settled entries once it is full
+    {
+        DnsCache small;
+        small.setResolver([](const std::string&) { return DnsAnswer{{"10.9.9.9"}, 300}; });
+        small.setMaxEntries(100);
+        std::vector<std::string> addresses;
+        for (int i = 0; i < 500; ++i) {
+            ok = ok && small.resolve("n" + std::to_string(i) + ".test", addresses) &&
+                 addresses == std::vector<std::string>{"10.9.9.9"};
+        }
+        ok = ok && small.stats().entries <= 100;
+    }
+
+    cache.stop();
+    ok = ok && !cache.prefetch("late.test");
+
+    if (!ok) {
+        LOG_ERROR("DnsCache test failed");
+        return 1;
+    }
+
+    LOG_INFO("DnsCache test finished");
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,89 @@
+#include "downloader.hpp"
+#include "synthetic_web.hpp"
+#include "logger.hpp"
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+
+int main() {
+    auto& logger = Logger::instance();
+    logger.setLevel(LoggerUtils::Level::INFO);
+
+    auto consoleSink = std::make_shared<ConsoleSink>();
+    logger.addSink(consoleSink);
+
+    LOG_INFO("Downloader test started");
+
+    // one page whose first byte is immediate but whose body takes 3 s, longer than the
+    // shortest adaptive timeout
+    SyntheticWebConfig config;
+    config.hosts = 1;
+    config.pages_per_host = 4;
+    config.min_page_bytes = 64 * 1024;
+    config.max_page_bytes = 64 * 1024;
+    config.body_ms = 3000;
+    SyntheticWebServer server(config);
+    if (!server.start()) {
+        LOG_ERROR("failed to start synthetic web server");
+        return 1;
+    }
+
+    const std::filesystem::path dir = std::filesystem::temp_directory_path() / "downloader_test";
+    std::filesystem::remove_all(dir);
+
+    ThreadPool pool;
+    pool.start(2);
+    Downloader& downloader = Downloader::instance(pool, dir.string(), "DownloaderTest/1.0");
+    downloader.setCompression(false);
+
+    std::mutex mutex;
+    std::atomic<int> done{0};
+    FetchResult fetched;
+    size_t body_bytes = 0;
+    downloader.setPageHandler([&](const FetchResult& result, const PageRef& page) {
+        std::lock_guard<std::mutex> lock(mutex);
+        fetched = result;
+        body_bytes = page ? page.size() : 0;
+        done.fetch_add(1);
+    });
+
+    // a host known for fast first bytes sits at the minimum timeout of 2 s
+    const std::string url = server.pageUrl(0, 1);
+    const std::string host = UrlUtils::host(url);
+    FetchOutcome fast;
+    fast.status = 200;
+    fast.latency_ms = 1.0;
+    for (int i = 0; i < 20; ++i) {
+        downloader.hosts().tryAcquire(host);
+        downloader.hosts().release(host, fast);
+    }
+    const long stall_ms = downloader.hosts().timeoutMs(host);
+
+    const auto start = std::chrono::steady_clock::now();
+    downloader.enqueue(url);
+    while (done.load() == 0 && std::chrono::steady_clock::now() - start < std::chrono::seconds(30)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    pool.stop();
+    server.stop();
+    std::filesystem::remove_all(dir);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    LOG_INFO("slow body: curl result ", fetched.code, ", status ", fetched.status, ", ", body_bytes, " bytes in ",
+             seconds, " s with a ", stall_ms, " ms host timeout");
+    const bool ok = done.load() == 1 && stall_ms < 3000 && fetched.code == CURLE_OK && fetched.status == 200 &&
+                    body_bytes > config.min_page_bytes / 2 && seconds >= 2.5;
+
+    if (!ok) {
+        LOG_ERROR("Downloader test failed");
+        return 1;
+    }
+
+    LOG_INFO("Downloader test finished");
+    return 0;
+}
\ No newline at end of file
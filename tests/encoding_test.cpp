@@ -0,0 +1,127 @@
+#include "encoding.hpp"
+#include "logger.hpp"
+#include <string>
+
+int main() {
+    auto& logger = Logger::instance();
+    logger.setLevel(LoggerUtils::Level::INFO);
+
+    auto consoleSink = std::make_shared<ConsoleSink>();
+    logger.addSink(consoleSink);
+
+    LOG_INFO("Encoding test started");
+
+    bool ok = true;
+
+    auto decode = [](const std::string& body, const std::string& content_type) {
+        std::string out;
+        EncodingUtils::toUtf8(body, EncodingUtils::detect(body, content_type), out);
+        return out;
+    };
+
+    // where the charset comes from: BOM over header over <meta>, then sniffing
+    {
+        EncodingInfo i = EncodingUtils::detect("\xEF\xBB\xBFhello", "text/html; charset=iso-8859-1");
+        ok = ok && i.charset == Charset::Utf8 && i.source == EncodingSource::Bom && i.bom == 3;
+
+        i = EncodingUtils::detect("<meta charset=shift_jis>", "text/html; Charset=\"Windows-1252\"");
+        ok = ok && i.charset == Charset::Windows1252 && i.source == EncodingSource::Header;
+
+        i = EncodingUtils::detect("<html><head><META CHARSET='Shift_JIS'></head>", "text/html");
+        ok = ok && i.charset == Charset::ShiftJis && i.source == EncodingSource::Meta;
+
+        i = EncodingUtils::detect("<meta http-equiv=\"Content-Type\" content=\"text/html; charset=euc-jp\">", "");
+        ok = ok && i.charset == Charset::Other && i.label == "euc-jp";
+
+        i = EncodingUtils::detect("<meta charset=utf-16>plain", "");
+        ok = ok && i.charset == Charset::Utf8;
+
+        // a declaration past the first 1024 bytes is not looked for
+        i = EncodingUtils::detect(std::string(2000, ' ') + "<meta charset=shift_jis>caf\xE9", "text/html");
+        ok = ok && i.charset == Charset::Windows1252 && i.source == EncodingSource::Sniffed && !i.valid_utf8;
+
+        i = EncodingUtils::detect("caf\xC3\xA9", "text/html");
+        ok = ok && i.charset == Charset::Utf8 && i.source == EncodingSource::Sniffed && i.valid_utf8;
+
+        // a declared UTF-8 body is not validated by detect(), decodePage() still checks it
+        i = EncodingUtils::detect("caf\xC3\xA9", "text/html; charset=utf-8");
+        ok = ok && i.source == EncodingSource::Header && !i.valid_utf8;
+
+        ok = ok && EncodingUtils::isTextType("application/xhtml+xml") && !EncodingUtils::isTextType("image/png");
+        ok = ok && EncodingUtils::isDocumentType("TEXT/HTML ; charset=utf-8", "") &&
+             EncodingUtils::isDocumentType("text/plain", "") && EncodingUtils::isDocumentType("", "<html>") &&
+             !EncodingUtils::isDocumentType("application/pdf", "%PDF") &&
+             !EncodingUtils::isDocumentType("text/css", "p {}") &&
+             !EncodingUtils::isDocumentType("", std::string("\x89PNG\r\n\x1a\n\0\0", 10));
+        if (!ok) {
+            LOG_ERROR("charset detection mismatch");
+            return 1;
+        }
+    }
+
+    // validation: overlongs, surrogates, out of range and truncated sequences fail, also
+    // when they sit right after a long ASCII run that takes the vector path
+    {
+        const std::string run(37, 'a');
+        const char* valid[] = {"", "ascii", "\xC2\xA9", "\xE2\x82\xAC", "\xF0\x9F\x98\x80", "\xED\x9F\xBF", "\xF4\x8F\xBF\xBF"};
+        const char* invalid[] = {"\x80", "\xC0\xAF", "\xC1\xBF", "\xE0\x80\xAF", "\xED\xA0\x80", "\xF4\x90\x80\x80",
+                                 "\xF5\x80\x80\x80", "\xE2\x82", "\xFF"};
+        for (const char* v : valid) {
+            ok = ok && EncodingUtils::isValidUtf8(v) && EncodingUtils::isValidUtf8(run + v + run);
+        }
+        for (const char* v : invalid) {
+            ok = ok && !EncodingUtils::isValidUtf8(v) && !EncodingUtils::isValidUtf8(run + v + run);
+        }
+        ok = ok && EncodingUtils::validUtf8Prefix("abc\xC3\xA9\xFF", 6) == 5;
+
+        // one U+FFFD per maximal ill-formed subpart
+        ok = ok && decode("a\xE2\x82z\xFF", "text/html; charset=utf-8") == "a\xEF\xBF\xBDz\xEF\xBF\xBD";
+        ok = ok && decode("\xF0\x9F\x98", "text/plain; charset=utf-8") == "\xEF\xBF\xBD";
+        if (!ok) {
+            LOG_ERROR("UTF-8 validation mismatch");
+            return 1;
+        }
+    }
+
+    // transcoding
+    {
+        ok = ok && decode("caf\xE9 \x80 \x93quoted\x94", "text/html; charset=ISO-8859-1") ==
+                   "caf\xC3\xA9 \xE2\x82\xAC \xE2\x80\x9Cquoted\xE2\x80\x9D";
+        ok = ok && decode(std::string("\xFF\xFE" "h\0i\0" "\x3D\xD8" "\x00\xDE" "\x00\xD8", 12), "") ==
+                   "hi\xF0\x9F\x98\x80\xEF\xBF\xBD";
+        ok = ok && decode(std::string("\xFE\xFF\0A\x30\x42", 6), "") == "A\xE3\x81\x82";
+        ok = ok && decode("\xEF\xBB\xBFtext", "") == "text";
+
+#if defined(ENCODING_ICONV) || defined(ENCODING_WINAPI)
+        const std::string sjis = decode("<meta charset=\"shift_jis\"><p>\x93\xFA\x96\x7B\x8C\xEA</p>", "text/html");
+        ok = ok && sjis == "<meta charset=\"shift_jis\"><p>\xE6\x97\xA5\xE6\x9C\xAC\xE8\xAA\x9E</p>";
+#endif
+        if (!ok) {
+            LOG_ERROR("transcoding mismatch");
+            return 1;
+        }
+    }
+
+    // valid UTF-8 passes through as the same page, anything else lands in a new one
+    {
+        PageBufferPool pool;
+        PageRef page = pool.acquire(64);
+        const std::string text = "<p>caf\xC3\xA9</p>";
+        page.append(text.data(), text.size());
+
+        EncodingInfo info = EncodingUtils::detect(page.view(), "text/html");
+        PageRef same = EncodingUtils::decodePage(page, info, pool);
+        ok = ok && info.valid_utf8 && same.data() == page.data() && page.useCount() == 2;
+
+        info.charset = Charset::Windows1252;
+        PageRef converted = EncodingUtils::decodePage(page, info, pool);
+        ok = ok && converted.data() != page.data() && converted.view() == "<p>caf\xC3\x83\xC2\xA9</p>";
+        if (!ok) {
+            LOG_ERROR("page pass-through mismatch");
+            return 1;
+        }
+    }
+
+    LOG_INFO("Encoding test finished");
+    return 0;
+}
\ No newline at end of file
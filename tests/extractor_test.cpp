@@ -0,0 +1,136 @@
+#include "extractor.hpp"
+#include "logger.hpp"
+#include <string>
+
+int main() {
+    auto& logger = Logger::instance();
+    logger.setLevel(LoggerUtils::Level::INFO);
+
+    auto consoleSink = std::make_shared<ConsoleSink>();
+    logger.addSink(consoleSink);
+
+    LOG_INFO("Extractor test started");
+
+    bool ok = true;
+
+    {
+        auto decode = [](const std::string& s) {
+            std::string out;
+            ParserUtils::decodeEntities(s, out);
+            return out;
+        };
+        ok = ok && decode("a &amp; b &lt;c&gt; &quot;d&quot;") == "a & b <c> \"d\"";
+        ok = ok && decode("caf&eacute; &euro;5 &#233; &#xE9; &#x1F600;") ==
+                   "caf\xC3\xA9 \xE2\x82\xAC" "5 \xC3\xA9 \xC3\xA9 \xF0\x9F\x98\x80";
+        ok = ok && decode("&#150; &#0; &#xD800;") == "\xE2\x80\x93 \xEF\xBF\xBD \xEF\xBF\xBD";
+        ok = ok && decode("AT&T &unknown; & &amp") == "AT&T &unknown; & &amp";
+        if (!ok) {
+            LOG_ERROR("entity decoding mismatch");
+            return 1;
+        }
+    }
+
+    const std::string article =
+        "<!DOCTYPE html><html><head><title>  Rivers &amp; Lakes\n of the North </title>"
+        "<meta property=\"og:description\" content=\"og text\">"
+        "<meta name=\"description\" content=\"A survey of  northern &quot;waters&quot;\">"
+        "<script>var menu = 'Home About';</script><style>p { color: red }</style></head><body>"
+        "<nav><ul><li><a href=\"/\">Home</a></li><li><a href=\"/news\">News</a></li>"
+        "<li><a href=\"/about\">About us</a></li></ul></nav>"
+        "<div class=\"Sidebar-Widget\"><p>Subscribe to our newsletter for weekly updates about rivers "
+        "and lakes and everything else that flows through the northern regions of the continent</p></div>"
+        "<article><h1>The great rivers</h1>"
+        "<p>The northern rivers carry meltwater from the mountains to the sea over hundreds of kilometres, "
+        "and their valleys have shaped how towns, roads and farms were laid out along the way for centuries.</p>"
+        "<p>Short aside.</p>"
+        "<p>Spring floods bring fertile silt to the <a href=\"/plains\">plains</a>, which is why most of the "
+        "old settlements sit on raised terraces just above the reach of the highest&nbsp;water marks.<br>"
+        "Caf&eacute; owners still measure the river by eye every morning.</p>"
+        "</article>"
+        "<div class=\"links\"><a href=\"/a\">Related story one</a> | <a href=\"/b\">Related story two</a> | "
+        "<a href=\"/c\">Related story three</a></div>"
+        "<footer><p>Copyright 2024 Rivers Inc. All rights reserved. Terms of use and privacy policy apply "
+        "to every page of this site and every article that appears here.</p></footer>"
+        "</body></html>";
+
+    Extractor extractor;
+    ExtractedPage page;
+    extractor.extract(article, page);
+
+    LOG_INFO("title '", page.title, "', ", page.content_blocks, " of ", page.blocks, " blocks kept");
+
+    ok = ok && page.title == "Rivers & Lakes of the North";
+    ok = ok && page.description == "A survey of northern \"waters\"";
+    ok = ok && page.text.find("The great rivers\nThe northern rivers carry meltwater") == 0;
+    ok = ok && page.text.find("Short aside.\n") != std::string::npos;
+    ok = ok && page.text.find("to the plains, which") != std::string::npos;
+    ok = ok && page.text.find("highest water marks. Caf\xC3\xA9 owners") != std::string::npos;
+    for (const char* boilerplate : {"Home", "newsletter", "Related story", "Copyright", "var menu", "color"}) {
+        ok = ok && page.text.find(boilerplate) == std::string::npos;
+    }
+    if (!ok) {
+        LOG_ERROR("article extraction mismatch:\n", page.text);
+        return 1;
+    }
+
+    // class hints match whole words, not substrings
+    {
+        using ExtractorUtils::boilerplateHint;
+        ok = ok && boilerplateHint("site-nav") && boilerplateHint("main_menu") && boilerplateHint("comments");
+        ok = ok && boilerplateHint("has-sidebar sidebar-left") && boilerplateHint("  Related  ");
+        ok = ok && !boilerplateHint("unavailable") && !boilerplateHint("promotion") && !boilerplateHint("no-sidebar");
+        ok = ok && !boilerplateHint("site-content no-sidebar") && !boilerplateHint("navigate-") && !boilerplateHint("");
+        if (!ok) {
+            LOG_ERROR("boilerplate hint mismatch");
+            return 1;
+        }
+    }
+
+    const std::string body =
+        "<article><h1>Lake ice</h1>"
+        "<p>Every winter the lakes freeze from the shallow bays outward, and by late January the ice on the "
+        "larger ones is thick enough to carry trucks along marked roads between the island villages.</p>"
+        "<p>The roads are measured daily by volunteers who drill test holes every few hundred metres and "
+        "post the readings at the landings, where drivers check them before setting out across the lake.</p>"
+        "</article>";
+    const std::string furniture =
+        "<div class=\"widget\"><p>Subscribe to our newsletter for weekly updates about rivers and lakes and "
+        "everything else that flows through the northern regions of the continent</p></div>";
+    const std::string footer = "<footer><p>Copyright 2024 Rivers Inc. All rights reserved.</p></footer>";
+
+    // a layout class that only names the sidebar hints nothing
+    extractor.extract("<html><body><div class=\"site-content no-sidebar\">" + body + "</div>" + footer +
+                      "</body></html>", page);
+    ok = ok && page.text.find("Lake ice\nEvery winter") == 0 && page.text.find("post the readings") != std::string::npos;
+
+    // a hinted wrapper around most of the page's text does not veto it, a hint inside it still counts
+    extractor.extract("<html><body><div class=\"layout sidebar-right\">" + body + furniture + "</div>" + footer +
+                      "</body></html>", page);
+    ok = ok && page.text.find("Lake ice\nEvery winter") == 0 && page.text.find("post the readings") != std::string::npos;
+    ok = ok && page.text.find("newsletter") == std::string::npos;
+
+    // a hinted block that is not most of the page stays out, however dense
+    extractor.extract("<html><body>" + body + "<div class=\"sidebar\">" + furniture + "</div>" + footer +
+                      "</body></html>", page);
+    ok = ok && page.text.find("Every winter") != std::string::npos && page.text.find("newsletter") == std::string::npos;
+    if (!ok) {
+        LOG_ERROR("hinted wrapper mismatch:\n", page.text);
+        return 1;
+    }
+
+    // the same output object is reused for the next page
+    extractor.extract("<html><head><meta property=\"og:description\" content=\"only og\"></head>"
+                      "<body><p>one two</p></body></html>", page);
+    ok = ok && page.title.empty() && page.description == "only og" && page.blocks == 1;
+
+    extractor.extract("", page);
+    ok = ok && page.text.empty() && page.blocks == 0;
+
+    if (!ok) {
+        LOG_ERROR("Extractor test failed");
+        return 1;
+    }
+
+    LOG_INFO("Extractor test finished");
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+#include "host_controller.hpp"
+#include "logger.hpp"
+#include <thread>
+#include <chrono>
+
+int main() {
+    auto& logger = Logger::instance();
+    logger.setLevel(LoggerUtils::Level::INFO);
+
+    auto consoleSink = std::make_shared<ConsoleSink>();
+    logger.addSink(consoleSink);
+
+    LOG_INFO("HostController test started");
+
+    HostController hosts;
+    hosts.setLimits(2.0, 1.0, 16.0);
+
+    bool ok = true;
+
+    // flat latency: the window should open up
+    for (int i = 0; i < 200; ++i) {
+        if (!hosts.tryAcquire("fast.example")) {
+            hosts.acquire("fast.example");
+        }
+        FetchOutcome outcome;
+        outcome.status = 200;
+        outcome.latency_ms = 10.0;
+        hosts.release("fast.example", outcome);
+    }
+    HostState fast = hosts.state("fast.example");
+    LOG_INFO("fast host limit after 200 flat fetches: ", fast.limit, ", timeout ", fast.timeout_ms, " ms");
+    ok = ok && fast.limit > 10.0 && fast.timeout_ms < 20000;
+
+    // the window caps concurrent slots
+    int granted = 0;
+    while (hosts.tryAcquire("slow.example")) {
+        ++granted;
+    }
+    LOG_INFO("new host granted ", granted, " slots");
+    ok = ok && granted == 2;
+
+    // throttled with Retry-After: halve the window and refuse until the deadline
+    FetchOutcome throttled;
+    throttled.status = 429;
+    throttled.retry_after_s = 1;
+    hosts.release("slow.example", throttled);
+    HostState slow = hosts.state("slow.example");
+    LOG_INFO("after 429: limit ", slow.limit, ", throttled ", slow.throttled);
+    ok = ok && slow.limit == 1.0 && slow.throttled == 1;
+    ok = ok && !hosts.tryAcquire("slow.example");
+    ok = ok && hosts.nextResume() != std::chrono::steady_clock::time_point::max();
+
+    FetchOutcome fine;
+    fine.status = 200;
+    fine.latency_ms = 50.0;
+    hosts.release("slow.example", fine);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    ok = ok && hosts.tryAcquire("slow.example");
+
+    // timeouts back off exponentially without Retry-After
+    FetchOutcome timeout;
+    timeout.timed_out = true;
+    hosts.release("slow.example", timeout);
+    ok = ok && hosts.state("slow.example").timeouts == 1 && !hosts.tryAcquire("slow.example");
+
+    // only a host that has answered over HTTP/2 is batched onto one connection
+    TransferCounters h1;
+    hosts.recordTransfer("h1.example", h1);
+    TransferCounters h2;
+    h2.http2 = true;
+    hosts.recordTransfer("h2.example", h2);
+    ok = ok && !hosts.multiplexes("h1.example") && hosts.multiplexes("h2.example") && !hosts.multiplexes("new.example");
+
+    if (!ok) {
+        LOG_ERROR("HostController test failed");
+        return 1;
+    }
+
+    LOG_INFO("HostController test finished");
+    return 0;
+}
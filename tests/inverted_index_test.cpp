@@ -0,0 +1,147 @@
+#include "inverted_index.hpp"
+#include "thread_pool.hpp"
+#include "logger.hpp"
+#include <filesystem>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+int main() {
+    auto& logger = Logger::instance();
+    logger.setLevel(LoggerUtils::Level::INFO);
+
+    auto consoleSink = std::make_shared<ConsoleSink>();
+    logger.addSink(consoleSink);
+
+    LOG_INFO("InvertedIndex test started");
+
+    const std::filesystem::path dir = std::filesystem::temp_directory_path() / "inverted_index_test";
+    std::filesystem::remove_all(dir);
+
+    bool ok = true;
+
+    // page i holds word w<k> for every k dividing i, so the expected AND results are known
+    const int docs = 3000;
+    auto page = [](int i) {
+        std::string html = "<html><head><title>Page " + std::to_string(i) + "</title>"
+                           "<script>var hidden = 'scriptword';</script></head><body><p>";
+        for (int k = 2; k <= 12; ++k) {
+            if (i % k == 0) {
+                html += "W" + std::to_string(k) + " &amp; ";
+            }
+        }
+        html += "common text</p></body></html>";
+        return html;
+    };
+    auto expected = [&](std::vector<int> ks) {
+        std::set<std::string> urls;
+        for (int i = 0; i < docs; ++i) {
+            bool all = true;
+            for (int k : ks) {
+                all = all && i % k == 0;
+            }
+            if (all) {
+                urls.insert("https://example.com/" + std::to_string(i));
+            }
+        }
+        return urls;
+    };
+    auto found = [](const std::vector<IndexHit>& hits) {
+        std::set<std::string> urls;
+        for (const auto& h : hits) {
+            urls.insert(h.url);
+        }
+        return urls;
+    };
+
+    {
+        InvertedIndex index(dir.string());
+        index.setFlushBytes(16 * 1024);   // many small segments, so merges kick in
+        index.setMergeFactor(4);
+
+        ThreadPool pool;
+        pool.start(4);
+        for (int i = 0; i < docs; ++i) {
+            pool.enqueue([&index, &page, i]() {
+                index.addDocument("https://example.com/" + std::to_string(i), page(i));
+            });
+        }
+        pool.stop();
+
+        // part of the documents are still in memory: search has to see them too
+        ok = ok && found(index.search("w6 w4", docs)) == expected({6, 4});
+        index.flush();
+
+        IndexStats s = index.stats();
+        LOG_INFO(s.docs, " docs, ", s.segments, " segments, ", s.flushes, " flushes, ", s.merges, " merges, ",
+                 s.docsPerSec(), " docs/sec");
+        ok = ok && s.docs == static_cast<uint64_t>(docs) && s.flushes > 4;
+
+        ok = ok && found(index.search("W3 w5", docs)) == expected({3, 5});
+        ok = ok && found(index.search("common", docs)).size() == static_cast<size_t>(docs);
+        ok = ok && index.search("scriptword").empty() && index.search("amp").empty();
+        ok = ok && index.search("w3 nosuchterm").empty();
+        ok = ok && index.search("page", 5).size() == 5;
+        if (!ok) {
+            LOG_ERROR("search mismatch before reopening");
+            return 1;
+        }
+    }
+
+    {
+        // the manifest brings back the merged segments
+        InvertedIndex index(dir.string());
+        IndexStats s = index.stats();
+        LOG_INFO("reopened: ", s.segments, " segments, ", s.disk_bytes, " bytes on disk");
+        ok = ok && s.segments > 0;
+        ok = ok && found(index.search("w12 w8", docs)) == expected({12, 8});
+
+        const uint32_t doc = index.addDocument("https://example.com/new", "<p>w7 freshword</p>");
+        std::vector<IndexHit> hits = index.search("freshword w7");
+        ok = ok && hits.size() == 1 && hits[0].doc == doc && doc == static_cast<uint32_t>(docs);
+    }
+
+    {
+        // a segment that fails to open is reported and stays in the manifest across rewrites
+        std::filesystem::path seg_path;
+        for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+            if (entry.path().extension() == ".idx") {
+                seg_path = entry.path();
+                break;
+            }
+        }
+        const std::filesystem::path aside = seg_path.string() + ".aside";
+        std::filesystem::rename(seg_path, aside);
+
+        {
+            InvertedIndex index(dir.string());
+            IndexStats s = index.stats();
+            ok = ok && s.unreadable_segments == 1 && index.unreadableSegments().size() == 1 &&
+                 index.unreadableSegments()[0] == seg_path.filename().string();
+            index.addDocument("https://example.com/later", "<p>laterword</p>");
+            index.flush(); // rewrites the manifest
+        }
+
+        std::filesystem::rename(aside, seg_path);
+        InvertedIndex index(dir.string());
+        IndexStats s = index.stats();
+        LOG_INFO("restored segment: ", s.segments, " segments, ", s.unreadable_segments, " unreadable");
+        ok = ok && s.unreadable_segments == 0;
+        ok = ok && found(index.search("w12 w8", docs)) == expected({12, 8}) && index.search("laterword").size() == 1;
+        if (!ok) {
+            LOG_ERROR("unreadable segment was dropped from the manifest");
+            return 1;
+        }
+    }
+
+    std::filesystem::remove_all(dir);
+
+    if (!ok) {
+        LOG_ERROR("InvertedIndex test failed");
+        return 1;
+    }
+
+    LOG_INFO("InvertedIndex test finished");
+    return 0;
+}
\ No newline at end of file
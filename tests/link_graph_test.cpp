@@ -0,0 +1,168 @@
+#include "link_graph.hpp"
+#include "thread_pool.hpp"
+#include "logger.hpp"
+#include <atomic>
+#include <cmath>
+#include <random>
+#include <set>
+#include <vector>
+
+// Plain dense power iteration over the same (deduplicated) edges
+static std::vector<double> referenceRank(size_t n, const std::set<std::pair<uint32_t, uint32_t>>& edge_set, double d) {
+    const std::vector<std::pair<uint32_t, uint32_t>> edges(edge_set.begin(), edge_set.end());
+    std::vector<uint32_t> out(n, 0);
+    for (const auto& e : edges) {
+        ++out[e.first];
+    }
+    std::vector<double> rank(n, 1.0 / n);
+    for (int it = 0; it < 120; ++it) {
+        double dangling = 0.0;
+        for (size_t u = 0; u < n; ++u) {
+            if (!out[u]) dangling += rank[u];
+        }
+        std::vector<double> next(n, (1.0 - d) / n + d * dangling / n);
+        for (const auto& e : edges) {
+            next[e.second] += d * rank[e.first] / out[e.first];
+        }
+        rank.swap(next);
+    }
+    return rank;
+}
+
+int main() {
+    auto& logger = Logger::instance();
+    logger.setLevel(LoggerUtils::Level::INFO);
+
+    auto consoleSink = std::make_shared<ConsoleSink>();
+    logger.addSink(consoleSink);
+
+    LOG_INFO("LinkGraph test started");
+
+    ThreadPool pool;
+    pool.start(4);
+
+    bool ok = true;
+
+    // fingerprints are arbitrary 64-bit values; ids follow first appearance
+    auto fp = [](uint32_t i) { return 0x9E3779B97F4A7C15ull * (i + 1); };
+
+    {
+        LinkGraph graph;
+        std::set<std::pair<uint32_t, uint32_t>> edges; // (src, dst)
+
+        // 1..5 all link to the hub 0, which links back to 1; 6 links to 1 twice
+        for (uint32_t i = 1; i <= 5; ++i) {
+            graph.addEdges(fp(i), {fp(0)});
+            edges.insert({i, 0});
+        }
+        graph.addEdges(fp(0), {fp(1)});
+        graph.addEdges(fp(6), {fp(1), fp(1), fp(6)});
+        edges.insert({0, 1});
+        edges.insert({6, 1});
+        graph.compact();
+
+        LinkGraphStats s = graph.stats();
+        ok = ok && s.nodes == 7 && s.edges == edges.size() && s.pending_edges == 0;
+
+        graph.rank(&pool, 200, 1e-12);
+        std::vector<double> ref = referenceRank(7, edges, 0.85);
+        for (uint32_t i = 0; i < 7; ++i) {
+            ok = ok && std::fabs(graph.score(fp(i)) / 7.0 - ref[i]) < 1e-9;
+        }
+        ok = ok && graph.score(fp(0)) > graph.score(fp(2)) && graph.score(12345) == 0.0;
+
+        std::vector<double> batch;
+        graph.scores({fp(0), 12345, fp(2), fp(6)}, batch);
+        ok = ok && batch.size() == 4 && batch[0] == graph.score(fp(0)) && batch[1] == 0.0 &&
+             batch[2] == graph.score(fp(2)) && batch[3] == graph.score(fp(6));
+        LOG_INFO("hub score ", graph.score(fp(0)), ", leaf score ", graph.score(fp(2)));
+        if (!ok) {
+            LOG_ERROR("small graph mismatch");
+            return 1;
+        }
+    }
+
+    {
+        // a crawl-shaped graph built in rounds, compacted and re-ranked after each one
+        const uint32_t nodes = 50000;
+        const int rounds = 4;
+        std::mt19937 rng(7);
+        LinkGraph graph;
+        std::set<std::pair<uint32_t, uint32_t>> edges;
+
+        int cold = 0;
+        for (int r = 0; r < rounds; ++r) {
+            for (uint32_t u = r * nodes / rounds; u < (r + 1) * nodes / rounds; ++u) {
+                std::vector<uint64_t> to;
+                for (int k = 0; k < 20; ++k) {
+                    // mostly nearby pages (same site section), some far away
+                    uint32_t v = (rng() % 4) ? (u + rng() % 200) % nodes : rng() % nodes;
+                    to.push_back(fp(v));
+                    if (v != u) {
+                        edges.insert({u, v});
+                    }
+                }
+                graph.addEdges(fp(u), to);
+            }
+            ok = ok && graph.compactionDue(); // a quarter of the graph is new each round
+            graph.compact();
+            const int iterations = graph.rank(&pool, 100, 1e-9);
+            if (r == 0) cold = iterations;
+        }
+
+        // a few new links barely move the ranks, so the warm start converges quickly
+        for (int k = 0; k < 200; ++k) {
+            uint32_t u = rng() % nodes;
+            uint32_t v = rng() % nodes;
+            graph.addEdges(fp(u), {fp(v)});
+            if (u != v) {
+                edges.insert({u, v});
+            }
+        }
+        ok = ok && !graph.compactionDue() && graph.pendingEdges() > 0;
+
+        // compacted and ranked in a pool task, while lookups go on with the previous scores
+        std::atomic<bool> ranked{false};
+        std::atomic<int> warm{0};
+        pool.enqueue([&]() {
+            graph.compact();
+            warm = graph.rank(&pool, 100, 1e-9);
+            ranked = true;
+        });
+        size_t lookups = 0;
+        std::vector<double> batch;
+        while (!ranked) {
+            graph.scores({fp(lookups % nodes), fp(7)}, batch);
+            ++lookups;
+        }
+        LOG_INFO(lookups, " score lookups while ranking");
+
+        LinkGraphStats s = graph.stats();
+        LOG_INFO(s.nodes, " nodes, ", s.edges, " edges, ", s.bytesPerEdge(), " bytes/edge (",
+                 s.csrBytesPerEdge(), " in the CSR), ", s.compactions, " compactions, iterations cold ", cold,
+                 " / warm ", warm);
+        // ids, out-degrees and ranks cost at least 12 bytes per node on top of the CSR
+        ok = ok && s.edges == edges.size() && s.csrBytesPerEdge() < 4.0 && warm < cold;
+        ok = ok && s.totalBytes() >= s.csr_bytes + s.nodes * (sizeof(uint64_t) + sizeof(uint32_t) + sizeof(double)) &&
+             s.bytesPerEdge() < 8.0;
+
+        // re-ranking from scratch agrees with the incremental result
+        std::vector<double> ref = referenceRank(nodes, edges, 0.85);
+        double err = 0.0;
+        for (uint32_t i = 0; i < nodes; ++i) {
+            err += std::fabs(graph.score(fp(i)) / nodes - ref[i]);
+        }
+        LOG_INFO("L1 error against reference ", err);
+        ok = ok && err < 1e-6;
+    }
+
+    pool.stop();
+
+    if (!ok) {
+        LOG_ERROR("LinkGraph test failed");
+        return 1;
+    }
+
+    LOG_INFO("LinkGraph test finished");
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,85 @@
+#include "page_buffer.hpp"
+#include "thread_pool.hpp"
+#include "logger.hpp"
+#include <atomic>
+#include <string>
+
+int main() {
+    auto& logger = Logger::instance();
+    logger.setLevel(LoggerUtils::Level::INFO);
+
+    auto consoleSink = std::make_shared<ConsoleSink>();
+    logger.addSink(consoleSink);
+
+    LOG_INFO("PageBufferPool test started");
+
+    PageBufferPool pool;
+    pool.setLimits(4, 1 << 20);
+
+    bool ok = true;
+
+    {
+        PageRef page = pool.acquire();
+        const std::string chunk(1000, 'x');
+        for (int i = 0; i < 10; ++i) {
+            page.append(chunk.data(), chunk.size());
+        }
+        const char* before = page.data();
+
+        PageRef shared = page;
+        PageRef moved = std::move(page);
+        ok = ok && !page && moved.data() == before && shared.data() == before;
+        ok = ok && moved.useCount() == 2 && moved.size() == 10000;
+
+        PagePoolStats s = pool.stats();
+        ok = ok && s.slabs_in_use == 1 && s.slabs_free == 0;
+    }
+
+    PagePoolStats after = pool.stats();
+    LOG_INFO("after release: ", after.slabs_free, " free slab(s), ", after.bytes_free, " bytes parked");
+    ok = ok && after.slabs_in_use == 0 && after.slabs_free == 1 && after.bytes_free >= 10000;
+
+    // producers fill pages, consumers on the pool share them, the last one returns the slab
+    ThreadPool workers;
+    workers.start(4);
+    std::atomic<uint64_t> checked{0};
+
+    for (int i = 0; i < 200; ++i) {
+        PageRef page = pool.acquire(512);
+        std::string body = "page " + std::to_string(i);
+        page.append(body.data(), body.size());
+
+        workers.enqueue([page, body, &checked]() {
+            if (page.view() == body) {
+                checked.fetch_add(1);
+            }
+        });
+        workers.enqueue([page = std::move(page), body, &checked]() {
+            if (page.view() == body) {
+                checked.fetch_add(1);
+            }
+        });
+    }
+    workers.stop();
+
+    PagePoolStats s = pool.stats();
+    LOG_INFO("acquired ", s.acquired, ", reused ", s.reused, ", live slabs ", s.slabs_total,
+             ", discarded ", s.discarded, ", reserved ", s.bytes_reserved, " bytes");
+
+    ok = ok && checked.load() == 400 && s.slabs_in_use == 0 && s.acquired == 201;
+    ok = ok && s.slabs_free <= 4 && s.reused > 0;
+
+    // oversized slabs are not kept
+    {
+        PageRef big = pool.acquire(2 << 20);
+    }
+    ok = ok && pool.stats().discarded == s.discarded + 1;
+
+    if (!ok) {
+        LOG_ERROR("PageBufferPool test failed");
+        return 1;
+    }
+
+    LOG_INFO("PageBufferPool test finished");
+    return 0;
+}
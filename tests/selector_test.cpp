@@ -0,0 +1,188 @@
+#include "selector.hpp"
+#include "parser.hpp"
+#include "thread_pool.hpp"
+#include "logger.hpp"
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+static std::string describe(const std::vector<const Node*>& nodes) {
+    std::string out;
+    for (const Node* n : nodes) {
+        if (!out.empty()) {
+            out += ' ';
+        }
+        out += n->name;
+        auto id = n->attributes.find("id");
+        if (id != n->attributes.end()) {
+            out += '#' + id->second;
+        }
+    }
+    return out;
+}
+
+int main() {
+    auto& logger = Logger::instance();
+    logger.setLevel(LoggerUtils::Level::INFO);
+
+    auto consoleSink = std::make_shared<ConsoleSink>();
+    logger.addSink(consoleSink);
+
+    LOG_INFO("Selector test started");
+
+    ThreadPool pool;
+    pool.start(2);
+    Parser& parser = Parser::instance(pool);
+
+    bool ok = true;
+
+    const std::string html =
+        "<!DOCTYPE html><html><head><title>Shop &amp; blog</title>"
+        "<link rel=\"canonical\" href=\"https://shop.example.com/item?id=1&amp;v=2\">"
+        "<script>if (a < b && c) {}</script></head>"
+        "<body><div id=\"main\" class=\"page wide\">"
+        "<p id=\"p1\" class=\"lead big\">Intro<br>text"
+        "<p id=\"p2\">Second <span id=\"s1\" class=\"tag\">one</span></p>"
+        "<article id=\"a1\"><div id=\"d1\" class=\"price\" data-x>19.99</div>"
+        "<p id=\"p3\" CLASS=\"lead\"><a id=\"l1\" href=\"https://example.com\">x</a>"
+        "<a id=\"l2\" href=\"/local\" lang=\"en-GB\">y</a></p>"
+        "<time id=\"t1\" datetime=\"2024-03-01\">March</time></article>"
+        "<ul><li id=\"i1\" class=\"item\">1<li id=\"i2\" class=\"item sale\">2<li id=\"i3\">3</ul>"
+        "<div id=\"d2\"><span id=\"s2\" class=\"tag\" title=\"a b c\">z</span></div>"
+        "</div></body></html>";
+
+    std::unique_ptr<Node> root = parser.parse(html);
+
+    // tree shape: implied </p> and </li>, void elements, decoded attributes, raw script text
+    {
+        SelectorSet check;
+        const int canonical = check.add("link[rel=canonical]");
+        const int main_p = check.add("#main > p");
+        const int li = check.add("ul > li");
+        const int br = check.add("p > br");
+        const int script = check.add("head script");
+        auto found = check.matchAll(*root);
+
+        ok = ok && found[canonical].size() == 1 &&
+             found[canonical][0]->attributes.at("href") == "https://shop.example.com/item?id=1&v=2";
+        ok = ok && describe(found[main_p]) == "p#p1 p#p2";
+        ok = ok && describe(found[li]) == "li#i1 li#i2 li#i3";
+        ok = ok && found[br].size() == 1 && found[br][0]->children.empty();
+        ok = ok && found[script].size() == 1 && found[script][0]->children[0]->text == "if (a < b && c) {}";
+        if (!ok) {
+            LOG_ERROR("parse tree mismatch");
+            return 1;
+        }
+    }
+
+    SelectorSet selectors;
+    const std::vector<std::pair<std::string, std::string>> cases = {
+        {"div.price", "div#d1"},
+        {"article p", "p#p3"},
+        {"#main p.lead", "p#p1 p#p3"},
+        {"p.lead.big", "p#p1"},
+        {"a[href^='https']", "a#l1"},
+        {"a[href$=local]", "a#l2"},
+        {"a[lang|=en]", "a#l2"},
+        {"[title~=b]", "span#s2"},
+        {"*[data-x]", "div#d1"},
+        {"time[datetime*=\"03\"]", "time#t1"},
+        {"ul li.item, span.tag", "span#s1 li#i1 li#i2 span#s2"},
+        {"li.item.sale, li.sale", "li#i2"},
+        {"div > span", "span#s2"},
+        {"DIV#main > ARTICLE > *", "div#d1 p#p3 time#t1"},
+        {"body div div", "div#d1 div#d2"},
+        {"html > div", ""},
+        {".wide .tag", "span#s1 span#s2"},
+        {"#nosuch, p#p2", "p#p2"},
+    };
+    for (const auto& c : cases) {
+        ok = ok && selectors.add(c.first) >= 0;
+    }
+    for (const char* bad : {"a:hover", "a + b", "p ~ p", "[x", "", "div,", "a[href=]", "#"}) {
+        ok = ok && selectors.add(bad) == -1 && !selectors.error().empty();
+    }
+    ok = ok && selectors.add("ul > li:first-child") == -1 && selectors.errorPosition() == 7 &&
+         selectors.error() == "unexpected ':' at offset 7";
+    ok = ok && selectors.add("a[href") == -1 && selectors.errorPosition() == 6 &&
+         selectors.error() == "unexpected end at offset 6";
+    ok = ok && selectors.add("a + b") == -1 && selectors.errorPosition() == 2;
+    {
+        SelectorSet scratch;
+        ok = ok && scratch.add("a:hover") == -1 && scratch.add("a") == 0 && scratch.error().empty();
+    }
+    ok = ok && selectors.size() == cases.size();
+    if (!ok) {
+        LOG_ERROR("selector compile mismatch");
+        return 1;
+    }
+
+    auto found = selectors.matchAll(*root);
+    for (size_t i = 0; i < cases.size(); ++i) {
+        if (describe(found[i]) != cases[i].second) {
+            LOG_ERROR("'", cases[i].first, "' matched '", describe(found[i]), "', expected '", cases[i].second, "'");
+            ok = false;
+        }
+    }
+    if (!ok) {
+        return 1;
+    }
+
+    // a bigger page: all selectors in one pass agree with one set per selector
+    std::string page = "<html><body>";
+    for (int i = 0; i < 400; ++i) {
+        page += "<div class=\"row r" + std::to_string(i % 7) + "\" id=\"row" + std::to_string(i) + "\">"
+                "<section class=\"s" + std::to_string(i % 3) + "\"><p class=\"lead\">t <a href=\"/x/" +
+                std::to_string(i) + "\" class=\"link\">a</a></p><span data-i=\"" + std::to_string(i) +
+                "\">s</span></section></div>";
+    }
+    page += "</body></html>";
+    std::unique_ptr<Node> big = parser.parse(page);
+
+    const std::vector<std::string> rules = {
+        "div.r3 p", "section.s1 > p > a.link", "div > section span[data-i^='1']", "a[href$='7']",
+        ".row .lead", "body > div.r0.row", "section p a", "#row42 span", "div span, div a.link", "*.s2 > *"
+    };
+    SelectorSet together;
+    for (const auto& r : rules) {
+        together.add(r);
+    }
+    auto all = together.matchAll(*big);
+    size_t total = 0;
+    for (size_t i = 0; i < rules.size(); ++i) {
+        SelectorSet alone;
+        alone.add(rules[i]);
+        ok = ok && alone.matchAll(*big)[0] == all[i] && !all[i].empty();
+        total += all[i].size();
+    }
+    LOG_INFO(rules.size(), " selectors matched ", total, " elements in one pass");
+    if (!ok) {
+        LOG_ERROR("combined matching differs from single selectors");
+        return 1;
+    }
+
+    // batch: parse tasks on the pool share the compiled set
+    std::vector<std::string> pages(16, page);
+    std::atomic<size_t> matched{0};
+    std::atomic<size_t> done{0};
+    const size_t queued = parser.parseBatch(pages, [&](size_t, const Node& tree) {
+        together.match(tree, [&](int, const Node&) { matched.fetch_add(1); });
+        done.fetch_add(1);
+    });
+    while (done.load() < queued) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ok = ok && queued == pages.size() && matched.load() == total * pages.size();
+
+    pool.stop();
+
+    if (!ok) {
+        LOG_ERROR("Selector test failed");
+        return 1;
+    }
+
+    LOG_INFO("Selector test finished");
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,226 @@
+#include "sitemap.hpp"
+#include "crawler.hpp"
+#include "logger.hpp"
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifdef SITEMAP_GZIP
+static std::string gzipString(const std::string& in) {
+    z_stream zs;
+    std::memset(&zs, 0, sizeof(zs));
+    deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+    std::string out(deflateBound(&zs, static_cast<uLong>(in.size())), '\0');
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+    zs.avail_in = static_cast<uInt>(in.size());
+    zs.next_out = reinterpret_cast<Bytef*>(&out[0]);
+    zs.avail_out = static_cast<uInt>(out.size());
+    deflate(&zs, Z_FINISH);
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+    return out;
+}
+#endif
+
+int main() {
+    auto& logger = Logger::instance();
+    logger.setLevel(LoggerUtils::Level::INFO);
+
+    auto consoleSink = std::make_shared<ConsoleSink>();
+    logger.addSink(consoleSink);
+
+    LOG_INFO("Sitemap test started");
+
+    bool ok = true;
+
+    const std::string urlset =
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        "<!-- generated -->\n"
+        "<urlset xmlns=\"http://www.sitemaps.org/schemas/sitemap/0.9\" "
+        "xmlns:image=\"http://www.google.com/schemas/sitemap-image/1.1\">\n"
+        "  <url>\n"
+        "    <loc> https://example.com/a?x=1&amp;y=2 </loc>\n"
+        "    <lastmod>2024-05-01T10:00:00+00:00</lastmod>\n"
+        "    <priority>0.8</priority>\n"
+        "    <image:image><image:loc>https://cdn.example.com/a.jpg</image:loc></image:image>\n"
+        "  </url>\n"
+        "  <url><loc><![CDATA[https://example.com/b]]></loc></url>\n"
+        "  <url><lastmod>2024-01-01</lastmod></url>\n"
+        "  <url><loc>https://example.com/&#99;</loc><priority>7</priority></url>\n"
+        "</urlset>\n";
+
+    // the same document cut at every possible place has to parse the same
+    for (size_t step : {size_t(1), size_t(3), size_t(17), urlset.size()}) {
+        std::vector<SitemapEntry> entries;
+        SitemapStream stream([&](SitemapEntry&& e, SitemapUtils::EntryType type) {
+            if (type == SitemapUtils::EntryType::Url) {
+                entries.push_back(std::move(e));
+            }
+        });
+        for (size_t i = 0; i < urlset.size(); i += step) {
+            stream.write(urlset.data() + i, std::min(step, urlset.size() - i));
+        }
+        ok = ok && stream.finish() && !stream.isIndex();
+        ok = ok && entries.size() == 3;
+        if (entries.size() == 3) {
+            ok = ok && entries[0].loc == "https://example.com/a?x=1&y=2";
+            ok = ok && entries[0].lastmod == "2024-05-01T10:00:00+00:00";
+            ok = ok && entries[0].priority == 0.8;
+            ok = ok && entries[1].loc == "https://example.com/b" && entries[1].priority < 0.0;
+            ok = ok && entries[2].loc == "https://example.com/c" && entries[2].priority == 1.0;
+        }
+        if (!ok) {
+            LOG_ERROR("urlset parse failed with step ", step);
+            return 1;
+        }
+    }
+
+    const std::string index =
+        "<sitemapindex xmlns=\"http://www.sitemaps.org/schemas/sitemap/0.9\">"
+        "<sitemap><loc>https://example.com/s1.xml.gz</loc><lastmod>2024-01-01</lastmod></sitemap>"
+        "<sitemap><loc>https://example.com/s2.xml</loc></sitemap>"
+        "</sitemapindex>";
+    std::vector<std::string> children;
+    SitemapStream index_stream([&](SitemapEntry&& e, SitemapUtils::EntryType type) {
+        if (type == SitemapUtils::EntryType::Sitemap) {
+            children.push_back(e.loc);
+        }
+    });
+    index_stream.write(index.data(), index.size());
+    ok = ok && index_stream.finish() && index_stream.isIndex();
+    ok = ok && children.size() == 2 && children[0] == "https://example.com/s1.xml.gz";
+    LOG_INFO("index: ", children.size(), " child sitemaps");
+
+    // fresher and higher-priority entries rank first
+    SitemapEntry fresh{"https://example.com/x", "2024-06-01", 0.5};
+    SitemapEntry stale{"https://example.com/y", "2019-06-01", 0.5};
+    SitemapEntry plain{"https://example.com/z", "", -1.0};
+    const long today = SitemapUtils::lastmodDays("2024-06-10");
+    ok = ok && SitemapUtils::lastmodDays("1970-01-02") == 1 && SitemapUtils::lastmodDays("garbage") == -1;
+    ok = ok && SitemapUtils::seedPriority(fresh, today) > SitemapUtils::seedPriority(stale, today);
+    ok = ok && SitemapUtils::seedPriority(plain, today) > 0.0;
+
+#ifdef SITEMAP_GZIP
+    // a large gzip sitemap streamed in small pieces
+    std::string big = "<urlset>";
+    const int n = 50000;
+    for (int i = 0; i < n; ++i) {
+        big += "<url><loc>https://example.com/p/" + std::to_string(i) + "</loc></url>\n";
+    }
+    big += "</urlset>";
+    const std::string gz = gzipString(big);
+
+    size_t count = 0;
+    SitemapStream gz_stream([&](SitemapEntry&&, SitemapUtils::EntryType) {
+        ++count;
+    });
+    for (size_t i = 0; i < gz.size(); i += 1000) {
+        gz_stream.write(gz.data() + i, std::min<size_t>(1000, gz.size() - i));
+    }
+    ok = ok && gz_stream.finish() && count == static_cast<size_t>(n) && gz_stream.bytesXml() == big.size();
+    LOG_INFO("gzip: ", gz.size(), " -> ", gz_stream.bytesXml(), " bytes, ", count, " URLs");
+
+    SitemapStream truncated([](SitemapEntry&&, SitemapUtils::EntryType) {});
+    truncated.write(gz.data(), gz.size() / 2);
+    ok = ok && !truncated.finish();
+#endif
+
+    if (!ok) {
+        LOG_ERROR("Sitemap test failed");
+        return 1;
+    }
+
+    // SitemapLoader over local files: index -> a, nested index -> b, deeper index -> c
+    const std::filesystem::path dir = std::filesystem::temp_directory_path() / "sitemap_test";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    auto path = [&](const std::string& name) {
+        return (dir / name).string();
+    };
+    auto write = [&](const std::string& name, const std::string& body) {
+        std::ofstream(path(name), std::ios::binary) << body;
+    };
+    auto sitemapIndex = [](const std::vector<std::string>& locs) {
+        std::string body = "<sitemapindex>";
+        for (const auto& loc : locs) {
+            body += "<sitemap><loc>" + loc + "</loc></sitemap>";
+        }
+        return body + "</sitemapindex>";
+    };
+    auto urlSet = [](const std::string& prefix, int n) {
+        std::string body = "<urlset>";
+        for (int i = 0; i < n; ++i) {
+            body += "<url><loc>https://example.com/" + prefix + std::to_string(i) + "</loc></url>";
+        }
+        return body + "</urlset>";
+    };
+
+#ifdef SITEMAP_GZIP
+    const std::string b_name = "b.xml.gz";
+    write(b_name, gzipString(urlSet("b", 2)));
+#else
+    const std::string b_name = "b.xml";
+    write(b_name, urlSet("b", 2));
+#endif
+    write("root.xml", sitemapIndex({path("a.xml"), path("nested.xml"), path("missing.xml"), path("a.xml")}));
+    write("a.xml", urlSet("a", 3));
+    write("nested.xml", sitemapIndex({path(b_name), path("deeper.xml")}));
+    write("deeper.xml", sitemapIndex({path("c.xml")}));
+    write("c.xml", urlSet("c", 1));
+
+    std::vector<SitemapEntry> seeds;
+    std::vector<size_t> batch_sizes;
+    SitemapLoader loader;
+    loader.setBatchSize(2);
+    SitemapStats ls = loader.load(path("root.xml"), [&](std::vector<SitemapEntry>& batch) {
+        batch_sizes.push_back(batch.size());
+        for (auto& e : batch) {
+            seeds.push_back(std::move(e));
+        }
+    });
+    LOG_INFO("loader: ", ls.urls, " URLs in ", ls.batches, " batches from ", ls.sitemaps_loaded, " sitemaps (",
+             ls.indexes, " indexes, ", ls.sitemaps_failed, " failed)");
+    // c.xml sits below the default depth of 2, a.xml is listed twice but read once
+    ok = ok && ls.urls == 5 && seeds.size() == 5 && ls.sitemaps_loaded == 5 && ls.indexes == 3 &&
+         ls.sitemaps_failed == 1 && ls.batches == 3 && batch_sizes == std::vector<size_t>{2, 2, 1};
+    ok = ok && seeds[0].loc == "https://example.com/a0" && seeds[3].loc == "https://example.com/b0";
+
+    loader.setMaxDepth(3);
+    ls = loader.load(path("root.xml"), [](std::vector<SitemapEntry>&) {});
+    ok = ok && ls.urls == 6 && ls.sitemaps_loaded == 6;
+
+    loader.setMaxSitemaps(2);
+    ls = loader.load(path("root.xml"), [](std::vector<SitemapEntry>&) {});
+    ok = ok && ls.urls == 3 && ls.sitemaps_loaded == 2 && ls.sitemaps_failed == 0;
+    if (!ok) {
+        LOG_ERROR("SitemapLoader mismatch");
+        return 1;
+    }
+
+    // seedBatch skips non-HTTP URLs and anything already queued, fragments included
+    {
+        ThreadPool pool;
+        pool.start(1);
+        Downloader& downloader = Downloader::instance(pool, path("downloads"), "SitemapTest/1.0");
+        downloader.setDnsPrefetch(false);
+        Crawler& crawler = Crawler::instance(downloader);
+
+        ok = ok && crawler.seedBatch(seeds) == 5;
+        std::vector<SitemapEntry> more = {
+            {"https://example.com/a0#top", "", -1.0},
+            {"ftp://example.com/file", "", -1.0},
+            {"https://example.com/new", "2024-01-01", 0.9},
+        };
+        ok = ok && crawler.seedBatch(more) == 1 && crawler.stats().urls_queued == 6;
+
+        // with the pool gone nothing can be fetched, and run() has to return rather than wait
+        pool.stop();
+        crawler.run();
+        ok = ok && crawler.stats().pages_fetched == 0;
+    }
+    std::filesystem::remove_all(dir);
+
+    LOG_INFO("Sitemap test finished");
+    return 0;
+}
\ No newline at end of file
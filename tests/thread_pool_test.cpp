@@ -35,8 +35,15 @@ int main() {
         pool.enqueue(std::bind(workerTask, i));
     }
 
+    bool running = !pool.stopped();
     pool.stop();
 
+    // a stopped pool says so and refuses work, which the crawler relies on to end its loop
+    if (!running || !pool.stopped() || pool.enqueue([]() {})) {
+        LOG_ERROR("stopped pool still accepts tasks");
+        return 1;
+    }
+
     auto end = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double> elapsed = end - start;
 
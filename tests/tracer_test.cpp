@@ -0,0 +1,130 @@
+#include "tracer.hpp"
+#include "logger.hpp"
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+// True if the complete ("X") events of every tid nest: each one either ends before the next
+// starts or contains it, which is what trace viewers need to stack them
+static bool slicesNest(const std::string& json) {
+    struct Slice {
+        long long ts;
+        long long end;
+    };
+    auto number = [](const std::string& line, const std::string& key) {
+        const size_t at = line.find("\"" + key + "\":");
+        return at == std::string::npos ? -1LL : std::stoll(line.substr(at + key.size() + 3));
+    };
+    std::map<long long, std::vector<Slice>> by_tid;
+    std::istringstream in(json);
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.find("\"ph\":\"X\"") != std::string::npos) {
+            const long long ts = number(line, "ts");
+            by_tid[number(line, "tid")].push_back(Slice{ts, ts + number(line, "dur")});
+        }
+    }
+    for (auto& kv : by_tid) {
+        std::sort(kv.second.begin(), kv.second.end(), [](const Slice& a, const Slice& b) {
+            return a.ts != b.ts ? a.ts < b.ts : a.end > b.end;
+        });
+        std::vector<long long> open;
+        for (const Slice& s : kv.second) {
+            while (!open.empty() && open.back() <= s.ts) {
+                open.pop_back();
+            }
+            if (!open.empty() && s.end > open.back()) {
+                return false;
+            }
+            open.push_back(s.end);
+        }
+    }
+    return true;
+}
+
+int main() {
+    auto& logger = Logger::instance();
+    logger.setLevel(LoggerUtils::Level::INFO);
+
+    auto consoleSink = std::make_shared<ConsoleSink>();
+    logger.addSink(consoleSink);
+
+    LOG_INFO("Tracer test started");
+
+    Tracer& tracer = Tracer::instance();
+    tracer.setCapacity(8);
+    tracer.setMode(TracerUtils::Mode::SAMPLED, 4);
+
+    // page saves run on another pool thread
+    std::thread::id saver;
+    std::thread([&saver]() { saver = std::this_thread::get_id(); }).join();
+
+    int sampled = 0;
+    for (int i = 0; i < 40; ++i) {
+        if (!tracer.shouldTrace()) {
+            continue;
+        }
+        ++sampled;
+
+        FetchTrace t;
+        t.url = "https://example.com/page/" + std::to_string(i) + "?q=\"quoted\"";
+        t.threadId = std::this_thread::get_id();
+        if (i % 8 == 0) {
+            t.saveThreadId = saver;
+        }
+        t.enqueued = std::chrono::steady_clock::now();
+        t.started = t.enqueued + std::chrono::microseconds(150);
+        t.namelookup_us = 1000;
+        t.connect_us = 3000;
+        t.appconnect_us = 9000;
+        t.pretransfer_us = 9100;
+        t.starttransfer_us = 40000;
+        t.total_us = 52000;
+        t.transferred = t.started + std::chrono::microseconds(t.total_us);
+        t.saving = t.transferred + std::chrono::microseconds(300);
+        t.stored = t.transferred + std::chrono::microseconds(800);
+        t.status = 200;
+        tracer.record(std::move(t));
+    }
+
+    std::ostringstream json;
+    tracer.writeChromeTrace(json);
+    const std::string out = json.str();
+
+    LOG_INFO("Sampled ", sampled, " of 40 fetches, kept ", tracer.size(), ", overwritten ", tracer.overwritten());
+
+    bool ok = sampled == 10 && tracer.size() == 8 && tracer.overwritten() == 2
+              && out.find("\"traceEvents\"") != std::string::npos
+              && out.find("\"name\":\"tls\"") != std::string::npos
+              && out.find("\"name\":\"save_page\"") != std::string::npos
+              && out.find("\\\"quoted\\\"") != std::string::npos;
+
+    // save_page starts when saving does, not when the transfer ended
+    const size_t save = out.find("\"name\":\"save_page\"");
+    const std::string event = save == std::string::npos ? "" : out.substr(save, out.find('}', save) - save);
+    ok = ok && event.find("\"dur\":500") != std::string::npos;
+
+    // the fetches were recorded as overlapping on one thread, the way a thread multiplexing
+    // transfers records them, and every save ran after its fetch ended
+    ok = ok && slicesNest(out) && out.find(" lane 1\"") != std::string::npos &&
+         out.find("\"ph\":\"f\",\"bp\":\"e\"") != std::string::npos;
+
+    const std::filesystem::path trace_path = std::filesystem::temp_directory_path() / "tracer_test_trace.json";
+    if (!tracer.exportChromeTrace(trace_path.string()) || std::filesystem::file_size(trace_path) != out.size()) {
+        ok = false;
+    }
+    std::filesystem::remove(trace_path);
+
+    if (!ok) {
+        LOG_ERROR("Tracer test failed");
+        return 1;
+    }
+
+    LOG_INFO("Tracer test finished");
+    return 0;
+}